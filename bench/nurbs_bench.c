@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Scaling of global interpolation, nurbs_new_curve_withP, over the point
+ * count. Usage: nurbs_bench [degree [largest n]], by default cubic up to
+ * 1024000 points, each size the best of a few runs.
+ */
+
+#include "nurbs_api.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_RUNS 5
+
+/* processor time, the interpolation runs on the calling thread only */
+static double bench_seconds(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* a wavy spiral, so no stretch of the data is straight */
+static void bench_points(nurbs_Point *pts, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double t = (double)i * 0.05;
+        pts[i].x = t + 0.3 * sin(7.0 * t);
+        pts[i].y = cos(t) * (1.0 + 0.1 * t);
+        pts[i].z = 0.2 * sin(3.0 * t);
+    }
+}
+
+/* largest distance from the data to the curve, the interpolation error */
+static double bench_error(const nurbs_Curve *curve, const nurbs_Point *pts,
+                          size_t n)
+{
+    double err = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        nurbs_Point c = nurbs_curve_closepoint(curve, &pts[i]);
+        double dx = c.x - pts[i].x, dy = c.y - pts[i].y, dz = c.z - pts[i].z;
+        err = fmax(err, sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    int degree = argc > 1 ? atoi(argv[1]) : 3;
+    size_t largest = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 1024000;
+
+    nurbs_Point *pts = (nurbs_Point *)malloc(largest * sizeof(nurbs_Point));
+    if (pts == NULL || degree < 1)
+        return 1;
+    bench_points(pts, largest);
+
+    double error = 0.0;
+    printf("degree %d\n%10s %12s %12s\n", degree, "n", "ms", "ns/point");
+    for (size_t n = 1000; n <= largest; n *= 4) {
+        double best = INFINITY;
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            double t0 = bench_seconds();
+            nurbs_Curve *curve =
+                nurbs_new_curve_withP(pts, (uint32_t)n, (uint8_t)degree);
+            double t1 = bench_seconds();
+            if (curve == NULL) {
+                fprintf(stderr, "interpolation of %zu points failed\n", n);
+                free(pts);
+                return 1;
+            }
+            if (run == 0 && n == 1000)
+                error = bench_error(curve, pts, n);
+            nurbs_free(curve);
+            best = fmin(best, t1 - t0);
+        }
+        printf("%10zu %12.3f %12.1f\n", n, best * 1e3, best * 1e9 / n);
+    }
+    printf("largest distance from 1000 points to their curve %.3g\n", error);
+    free(pts);
+    return 0;
+}
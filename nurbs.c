@@ -24,9 +24,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <assert.h>
+#include <limits.h>
+
+void nurbs_set_allocator(const nurbs_Allocator *allocator)
+{
+    nurbs__memSetGlobal(allocator);
+}
+
+const nurbs_Allocator *nurbs_set_thread_allocator(
+    const nurbs_Allocator *allocator)
+{
+    return nurbs__memSetThread(allocator);
+}
+
+void nurbs_free_buffer(void *buffer)
+{
+    nurbs__memFree(buffer);
+}
+
+void nurbs_scratch_trim(void)
+{
+    nurbs__memScratchTrim();
+}
 
 void nurbs_free(nurbs_Curve *curve)
 {
+    nurbs__makeFree(curve);
 }
 
 nurbs_Curve *nurbs_new_curve_withKCW(uint8_t degree, const nurbs_Point *cv,
@@ -34,30 +58,204 @@ nurbs_Curve *nurbs_new_curve_withKCW(uint8_t degree, const nurbs_Point *cv,
                                      uint32_t nknots, double *weights,
                                      uint32_t nweights)
 {
-    return NULL;
+    if (weights != NULL && nweights != ncv)
+        return NULL;
+    return nurbs__makeKCW(degree, cv, ncv, knots, nknots, weights);
+}
+
+size_t nurbs_curve_controlpoints(const nurbs_Curve *curve, nurbs_Point *points,
+                                 double *weights)
+{
+    const nurbs_PointArray *cv = curve->nurbs_data->cv;
+    if (points != NULL) {
+        nurbs__kernels()->unpack(cv->hpoints, cv->npoints, points, weights);
+    }
+    else if (weights != NULL) {
+        for (size_t i = 0; i < cv->npoints; ++i)
+            weights[i] = cv->hpoints[i].w;
+    }
+    return cv->npoints;
+}
+
+int nurbs_curve_set_controlpoints(nurbs_Curve *curve, size_t first,
+                                  const nurbs_Point *points,
+                                  const double *weights, size_t n)
+{
+    nurbs_PointArray *cv = curve->nurbs_data->cv;
+    if (first > cv->npoints || n > cv->npoints - first)
+        return NURBS_FALSE;
+    if (weights != NULL) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!(weights[i] > 0.0))
+                return NURBS_FALSE;
+        }
+    }
+
+    nurbs_HPoint *hp = cv->hpoints + first;
+    for (size_t i = 0; i < n; ++i) {
+        double w = weights != NULL ? weights[i] : hp[i].w;
+        hp[i].x = points[i].x * w;
+        hp[i].y = points[i].y * w;
+        hp[i].z = points[i].z * w;
+        hp[i].w = w;
+    }
+    /* the shape parameters of arcs and lines no longer describe the curve */
+    if (n != 0)
+        curve->type = NURBS_CURVE_NURBS;
+    return NURBS_TRUE;
 }
 
 nurbs_Curve *nurbs_new_curve_withP(const nurbs_Point *cv, uint32_t ncv,
                                    uint8_t degree)
 {
-    return NULL;
+    return nurbs__makeInterpolated(cv, ncv, degree);
+}
+
+nurbs_CurveFitter *nurbs_fitter_new(uint8_t degree, uint32_t ncv, double umin,
+                                    double umax)
+{
+    return nurbs__makeFitterNew(degree, ncv, umin, umax);
+}
+
+void nurbs_fitter_add(nurbs_CurveFitter *fitter, const nurbs_Point *points,
+                      const double *us, size_t n)
+{
+    nurbs__makeFitterAdd(fitter, points, us, n);
+}
+
+nurbs_Curve *nurbs_fitter_curve(const nurbs_CurveFitter *fitter, double *rms)
+{
+    return nurbs__makeFitterSolve(fitter, rms);
+}
+
+nurbs_Curve *nurbs_fitter_curve_tol(const nurbs_CurveFitter *fitter,
+                                    double tol, double *rms)
+{
+    return nurbs__makeFitterSolveTol(fitter, tol, rms);
+}
+
+void nurbs_fitter_free(nurbs_CurveFitter *fitter)
+{
+    nurbs__makeFitterFree(fitter);
+}
+
+nurbs_CurveStore *nurbs_store_new(size_t ncurves, size_t nknots,
+                                  size_t npoints)
+{
+    return nurbs__storeNew(ncurves, nknots, npoints);
+}
+
+void nurbs_store_free(nurbs_CurveStore *store)
+{
+    nurbs__storeFree(store);
+}
+
+int nurbs_store_append(nurbs_CurveStore *store, const nurbs_Curve *const *curves,
+                       size_t n, nurbs_CurveHandle *handles)
+{
+    return nurbs__storeAppend(store, curves, n, handles);
+}
+
+size_t nurbs_store_remove(nurbs_CurveStore *store,
+                          const nurbs_CurveHandle *handles, size_t n)
+{
+    return nurbs__storeRemove(store, handles, n);
+}
+
+size_t nurbs_store_count(const nurbs_CurveStore *store)
+{
+    return store->nrecords;
+}
+
+nurbs_CurveHandle nurbs_store_handle(const nurbs_CurveStore *store,
+                                     size_t index)
+{
+    assert(index < store->nrecords);
+    uint32_t slot = store->records[index].slot;
+    return NURBS__STOREHANDLE(slot, store->slots[slot].generation);
+}
+
+int nurbs_store_index(const nurbs_CurveStore *store, nurbs_CurveHandle handle,
+                      size_t *index)
+{
+    return nurbs__storeLookup(store, handle, index);
+}
+
+int nurbs_store_type(const nurbs_CurveStore *store, size_t index)
+{
+    assert(index < store->nrecords);
+    return store->records[index].type;
+}
+
+void nurbs_store_view(const nurbs_CurveStore *store, size_t index,
+                      nurbs_CurveView *view)
+{
+    nurbs__storeView(store, index, view);
+}
+
+int nurbs_store_append_arcs(nurbs_CurveStore *store, const nurbs_Point *centers,
+                            const nurbs_Vector *xaxes,
+                            const nurbs_Vector *yaxes, const double *radii,
+                            const double *minAngles, const double *maxAngles,
+                            size_t n, nurbs_CurveHandle *handles)
+{
+    return nurbs__makeStoreEllipseArcs(store, NURBS_CURVE_ARC, centers, xaxes,
+                                       yaxes, radii, minAngles, maxAngles, n,
+                                       handles);
+}
+
+int nurbs_store_append_circles(nurbs_CurveStore *store,
+                               const nurbs_Point *centers,
+                               const nurbs_Vector *xaxes,
+                               const nurbs_Vector *yaxes, const double *radii,
+                               size_t n, nurbs_CurveHandle *handles)
+{
+    return nurbs__makeStoreEllipseArcs(store, NURBS_CURVE_CIRCLE, centers,
+                                       xaxes, yaxes, radii, NULL, NULL, n,
+                                       handles);
+}
+
+int nurbs_store_append_ellipsearcs(nurbs_CurveStore *store,
+                                   const nurbs_Point *centers,
+                                   const nurbs_Vector *xaxes,
+                                   const nurbs_Vector *yaxes,
+                                   const double *minAngles,
+                                   const double *maxAngles, size_t n,
+                                   nurbs_CurveHandle *handles)
+{
+    return nurbs__makeStoreEllipseArcs(store, NURBS_CURVE_ELLIPSEARC, centers,
+                                       xaxes, yaxes, NULL, minAngles,
+                                       maxAngles, n, handles);
+}
+
+int nurbs_store_append_ellipses(nurbs_CurveStore *store,
+                                const nurbs_Point *centers,
+                                const nurbs_Vector *xaxes,
+                                const nurbs_Vector *yaxes, size_t n,
+                                nurbs_CurveHandle *handles)
+{
+    return nurbs__makeStoreEllipseArcs(store, NURBS_CURVE_ELLIPSE, centers,
+                                       xaxes, yaxes, NULL, NULL, NULL, n,
+                                       handles);
+}
+
+int nurbs_store_append_lines(nurbs_CurveStore *store, const nurbs_Point *starts,
+                             const nurbs_Point *ends, size_t n,
+                             nurbs_CurveHandle *handles)
+{
+    return nurbs__makeStoreLines(store, starts, ends, n, handles);
 }
 
 nurbs_Arc *nurbs_new_arc(const nurbs_Point *center, const nurbs_Vector *xaxis,
                          const nurbs_Vector *yaxis, double radius,
                          double minAngle, double maxAngle)
 {
-    nurbs_Arc *arc = (nurbs_Arc *)malloc(sizeof(nurbs_Arc));
+    nurbs_Arc *arc = (nurbs_Arc *)nurbs__makeArc(
+        sizeof(nurbs_Arc), center, xaxis, yaxis, radius, minAngle, maxAngle);
     if (arc == NULL)
         return NULL;
 
     arc->type = NURBS_CURVE_ARC;
-    arc->nurbs_data =
-        nurbs__makeArc(center, xaxis, yaxis, radius, minAngle, maxAngle);
-    if (arc->nurbs_data == NULL) {
-        free(arc);
-        return NULL;
-    };
     arc->_center = *center;
     arc->_xaxis = *xaxis;
     arc->_yaxis = *yaxis;
@@ -70,17 +268,11 @@ nurbs_Arc *nurbs_new_arc(const nurbs_Point *center, const nurbs_Vector *xaxis,
 nurbs_BezierCurve *nurbs_new_bezier(const nurbs_Point *points, uint32_t npoints,
                                     double *weights, int nw)
 {
-    nurbs_BezierCurve *bezier =
-        (nurbs_BezierCurve *)malloc(sizeof(nurbs_BezierCurve));
+    nurbs_BezierCurve *bezier = (nurbs_BezierCurve *)nurbs__makeRationalBezier(
+        sizeof(nurbs_BezierCurve), points, npoints, weights, nw);
     if (bezier == NULL)
         return NULL;
     bezier->type = NURBS_CURVE_BEZIER;
-    bezier->nurbs_data =
-        nurbs__makeRationalBezier(points, npoints, weights, nw);
-    if (bezier->nurbs_data == NULL) {
-        free(bezier);
-        return NULL;
-    }
     return bezier;
 }
 
@@ -88,16 +280,11 @@ nurbs_Circle *nurbs_new_circle(const nurbs_Point *center,
                                const nurbs_Vector *xaxis,
                                const nurbs_Vector *yaxis, double radius)
 {
-    nurbs_Circle *circle = (nurbs_Circle *)malloc(sizeof(nurbs_Circle));
+    nurbs_Circle *circle = (nurbs_Circle *)nurbs__makeArc(
+        sizeof(nurbs_Circle), center, xaxis, yaxis, radius, 0.0, 2.0 * M_PI);
     if (circle == NULL)
         return NULL;
     circle->type = NURBS_CURVE_CIRCLE;
-    circle->nurbs_data =
-        nurbs__makeArc(center, xaxis, yaxis, radius, 0.0, 2.0 * M_PI);
-    if (circle->nurbs_data == NULL) {
-        free(circle);
-        return NULL;
-    }
     circle->_center = *center;
     circle->_xaxis = *xaxis;
     circle->_yaxis = *yaxis;
@@ -112,17 +299,11 @@ nurbs_EllipseArc *nurbs_new_ellipsearc(const nurbs_Point *center,
                                        const nurbs_Vector *yaxis,
                                        double minAngle, double maxAngle)
 {
-    nurbs_EllipseArc *arc =
-        (nurbs_EllipseArc *)malloc(sizeof(nurbs_EllipseArc));
+    nurbs_EllipseArc *arc = (nurbs_EllipseArc *)nurbs__makeEllipseArc(
+        sizeof(nurbs_EllipseArc), center, xaxis, yaxis, minAngle, maxAngle);
     if (arc == NULL)
         return NULL;
     arc->type = NURBS_CURVE_ELLIPSEARC;
-    arc->nurbs_data =
-        nurbs__makeEllipseArc(center, xaxis, yaxis, minAngle, maxAngle);
-    if (arc->nurbs_data == NULL) {
-        free(arc);
-        return NULL;
-    }
     arc->_center = *center;
     arc->_xaxis = *xaxis;
     arc->_yaxis = *yaxis;
@@ -135,16 +316,11 @@ nurbs_Ellipse *nurbs_new_ellipse(const nurbs_Point *center,
                                  const nurbs_Vector *xaxis,
                                  const nurbs_Vector *yaxis)
 {
-    nurbs_Ellipse *ellipse = (nurbs_Ellipse *)malloc(sizeof(nurbs_Ellipse));
+    nurbs_Ellipse *ellipse = (nurbs_Ellipse *)nurbs__makeEllipseArc(
+        sizeof(nurbs_Ellipse), center, xaxis, yaxis, 0.0, 2.0 * M_PI);
     if (ellipse == NULL)
         return NULL;
     ellipse->type = NURBS_CURVE_ELLIPSE;
-    ellipse->nurbs_data =
-        nurbs__makeEllipseArc(center, xaxis, yaxis, 0.0, 2.0 * M_PI);
-    if (ellipse->nurbs_data == NULL) {
-        free(ellipse);
-        return NULL;
-    }
     ellipse->_center = *center;
     ellipse->_xaxis = *xaxis;
     ellipse->_yaxis = *yaxis;
@@ -155,16 +331,12 @@ nurbs_Ellipse *nurbs_new_ellipse(const nurbs_Point *center,
 
 nurbs_Line *nurbs_new_line(const nurbs_Point *start, const nurbs_Point *end)
 {
-    nurbs_Line *line = (nurbs_Line *)malloc(sizeof(nurbs_Line));
+    nurbs_Point points[2] = {*start, *end};
+    nurbs_Line *line =
+        (nurbs_Line *)nurbs__makePolyline(sizeof(nurbs_Line), points, 2);
     if (line == NULL)
         return NULL;
     line->type = NURBS_CURVE_LINE;
-    nurbs_Point points[2] = {*start, *end};
-    line->nurbs_data = nurbs__makePolyline(points, 2);
-    if (line->nurbs_data == NULL) {
-        free(line);
-        return NULL;
-    }
     line->_start = *start;
     line->_end = *end;
     return line;
@@ -177,79 +349,553 @@ nurbs_Curve *nurbs_curve_reverse(const nurbs_Curve *curve)
 
 void nurbs_curve_domain(const nurbs_Curve *curve, double *min, double *max)
 {
+    const nurbs_CurveData *data = curve->nurbs_data;
+    *min = data->knots[data->degree];
+    *max = data->knots[data->nknots - data->degree - 1];
 }
 
-nurbs_Curve *nurbs_curve_transform(const nurbs_Curve *curve, nurbs_Matrix mat)
+nurbs_Curve *nurbs_curve_transform(const nurbs_Curve *curve,
+                                   const nurbs_Matrix4 *matrix)
 {
-    return NULL;
+    nurbs_Curve *result = nurbs__makeCopy(curve->nurbs_data);
+    if (result == NULL)
+        return NULL;
+    nurbs__matTransformCurve(result->nurbs_data, matrix);
+    return result;
+}
+
+void nurbs_curve_transform_inplace(nurbs_Curve *curve,
+                                   const nurbs_Matrix4 *matrix)
+{
+    nurbs__matTransformCurve(curve->nurbs_data, matrix);
+
+    switch (curve->type) {
+    case NURBS_CURVE_ARC:
+    case NURBS_CURVE_CIRCLE:
+    case NURBS_CURVE_ELLIPSE:
+    case NURBS_CURVE_ELLIPSEARC: {
+        /* nurbs_Arc and nurbs_EllipseArc share the leading fields */
+        nurbs_EllipseArc *arc = (nurbs_EllipseArc *)curve;
+        if (!nurbs__matIsRigid4(matrix)) {
+            curve->type = NURBS_CURVE_NURBS;
+            break;
+        }
+        arc->_center = nurbs__matTransformPoint(matrix, arc->_center);
+        arc->_xaxis = nurbs__matTransformVector(matrix, arc->_xaxis);
+        arc->_yaxis = nurbs__matTransformVector(matrix, arc->_yaxis);
+        break;
+    }
+    case NURBS_CURVE_LINE: {
+        nurbs_Line *line = (nurbs_Line *)curve;
+        if (!nurbs__matIsAffine4(matrix)) {
+            curve->type = NURBS_CURVE_NURBS;
+            break;
+        }
+        line->_start = nurbs__matTransformPoint(matrix, line->_start);
+        line->_end = nurbs__matTransformPoint(matrix, line->_end);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void nurbs_matrix_identity(nurbs_Matrix4 *m)
+{
+    nurbs__matIdentity4(m);
+}
+
+void nurbs_matrix_translation(nurbs_Matrix4 *m, const nurbs_Vector *v)
+{
+    nurbs__matIdentity4(m);
+    m->m[0][3] = v->x;
+    m->m[1][3] = v->y;
+    m->m[2][3] = v->z;
+}
+
+void nurbs_matrix_rotation(nurbs_Matrix4 *m, const nurbs_Point *origin,
+                           const nurbs_Vector *axis, double angle)
+{
+    nurbs_Vector k = nurbs__vecNormalized(*axis);
+    double c = cos(angle), s = sin(angle), t = 1.0 - c;
+
+    nurbs__matIdentity4(m);
+    m->m[0][0] = c + t * k.x * k.x;
+    m->m[0][1] = t * k.x * k.y - s * k.z;
+    m->m[0][2] = t * k.x * k.z + s * k.y;
+    m->m[1][0] = t * k.x * k.y + s * k.z;
+    m->m[1][1] = c + t * k.y * k.y;
+    m->m[1][2] = t * k.y * k.z - s * k.x;
+    m->m[2][0] = t * k.x * k.z - s * k.y;
+    m->m[2][1] = t * k.y * k.z + s * k.x;
+    m->m[2][2] = c + t * k.z * k.z;
+
+    /* keep the origin fixed */
+    nurbs_Point r = nurbs__matTransformVector(m, *origin);
+    m->m[0][3] = origin->x - r.x;
+    m->m[1][3] = origin->y - r.y;
+    m->m[2][3] = origin->z - r.z;
+}
+
+void nurbs_matrix_compose(const nurbs_Matrix4 *a, const nurbs_Matrix4 *b,
+                          nurbs_Matrix4 *r)
+{
+    nurbs__matCompose4(a, b, r);
+}
+
+int nurbs_matrix_invert(const nurbs_Matrix4 *m, nurbs_Matrix4 *r)
+{
+    return nurbs__matInvert4(m, r);
 }
 
 nurbs_Point nurbs_curve_point(const nurbs_Curve *curve, double u)
 {
-    nurbs_Point p;
-    return p;
+    const nurbs_CurveData *data = curve->nurbs_data;
+    return nurbs__evalKernel(data->degree)->point(data, u);
+}
+
+int nurbs_curve_points(const nurbs_Curve *curve, const double *us, size_t n,
+                       double *x, double *y, double *z)
+{
+    return nurbs__evalCurvePoints(curve->nurbs_data, us, n, x, y, z);
 }
 
 nurbs_Vector nurbs_curve_tangent(const nurbs_Curve *curve, double u)
 {
-    nurbs_Vector p;
-    return p;
+    const nurbs_CurveData *data = curve->nurbs_data;
+    return nurbs__evalKernel(data->degree)->tangent(data, u);
 }
 
 int nurbs_curve_derivatives(const nurbs_Curve *curve, double u, int nderives,
                             nurbs_Vector **v, int *nv)
 {
-    return 0;
+    if (nderives < 0)
+        return NURBS_FALSE;
+
+    nurbs_Vector *ck = (nurbs_Vector *)nurbs__memAlloc(
+        (nderives + 1) * sizeof(nurbs_Vector));
+    if (ck == NULL)
+        return NURBS_FALSE;
+
+    nurbs__evalCurveDerivatives(curve->nurbs_data, u, nderives, ck);
+    *v = ck;
+    *nv = nderives + 1;
+    return NURBS_TRUE;
+}
+
+size_t nurbs_curve_derivatives_into(const nurbs_Curve *curve, double u,
+                                    size_t nderives, nurbs_Vector *v,
+                                    size_t first, size_t cap)
+{
+    size_t n = nderives + 1;
+    if (v == NULL || first >= n || cap == 0)
+        return n;
+
+    if (first == 0 && cap >= n) {
+        nurbs__evalCurveDerivatives(curve->nurbs_data, u, nderives, v);
+        return n;
+    }
+
+    /* a window of the result, derive everything in scratch and copy it */
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    nurbs_Vector *ck =
+        (nurbs_Vector *)nurbs__memScratchAlloc(n * sizeof(nurbs_Vector));
+    if (ck == NULL)
+        return 0;
+    nurbs__evalCurveDerivatives(curve->nurbs_data, u, nderives, ck);
+    memcpy(v, ck + first,
+           (n - first < cap ? n - first : cap) * sizeof(nurbs_Vector));
+    nurbs__memScratchRelease(mark);
+    return n;
+}
+
+void nurbs_cursor_init(nurbs_CurveCursor *cursor, const nurbs_Curve *curve)
+{
+    cursor->data = curve->nurbs_data;
+    cursor->span = cursor->data->degree;
+    cursor->u = NAN;
+}
+
+nurbs_Point nurbs_cursor_point(nurbs_CurveCursor *cursor, double u)
+{
+    nurbs_Point pt;
+    nurbs__evalCursorPoint(cursor, u, &pt, NULL);
+    return pt;
+}
+
+nurbs_Vector nurbs_cursor_tangent(nurbs_CurveCursor *cursor, double u)
+{
+    nurbs_Point pt;
+    nurbs_Vector d1;
+    nurbs__evalCursorPoint(cursor, u, &pt, &d1);
+    return d1;
+}
+
+nurbs_CompiledCurve *nurbs_curve_compile(const nurbs_Curve *curve)
+{
+    return nurbs__evalCompileCurve(curve->nurbs_data);
+}
+
+void nurbs_compiled_free(nurbs_CompiledCurve *cc)
+{
+    nurbs__memFree(cc);
+}
+
+nurbs_Point nurbs_compiled_point(const nurbs_CompiledCurve *cc, double u)
+{
+    nurbs_Point pt;
+    nurbs__evalCompiledPoint(cc, u, &pt, NULL);
+    return pt;
+}
+
+nurbs_Vector nurbs_compiled_tangent(const nurbs_CompiledCurve *cc, double u)
+{
+    nurbs_Point pt;
+    nurbs_Vector d1;
+    nurbs__evalCompiledPoint(cc, u, &pt, &d1);
+    return d1;
+}
+
+nurbs_CompiledCurveF *nurbs_curve_compilef(const nurbs_Curve *curve)
+{
+    return nurbs__evalCompileCurveF(curve->nurbs_data);
+}
+
+void nurbs_compiledf_free(nurbs_CompiledCurveF *cc)
+{
+    nurbs__memFree(cc);
+}
+
+void nurbs_compiledf_points(const nurbs_CompiledCurveF *cc, const double *us,
+                            size_t n, float *xyz)
+{
+    nurbs__evalCompiledPointsF(cc, us, n, xyz);
+}
+
+size_t nurbs_compiledf_sample(const nurbs_CompiledCurveF *cc, uint32_t nper,
+                              float *xyz)
+{
+    assert(nper > 0 && cc->nspans > 0);
+    size_t nv = (size_t)cc->nspans * nper + 1;
+    if (xyz == NULL)
+        return nv;
+
+    float step = 1.0f / nper;
+    for (size_t s = 0; s < cc->nspans; ++s) {
+        for (uint32_t i = 0; i < nper; ++i, xyz += 3)
+            nurbs__evalCompiledPointF(cc, s, i * step, xyz);
+    }
+    nurbs__evalCompiledPointF(cc, cc->nspans - 1, 1.0f, xyz);
+    return nv;
 }
 
 nurbs_Point nurbs_curve_closepoint(const nurbs_Curve *curve,
                                    const nurbs_Point *point)
 {
     nurbs_Point p;
+    if (isnan(nurbs__analyzeCloseParam(curve->nurbs_data, point, &p)))
+        p.x = p.y = p.z = NAN;
     return p;
 }
 
 double nurbs_curve_closeparam(const nurbs_Curve *curve,
                               const nurbs_Point *point)
 {
-    return 0.0;
+    return nurbs__analyzeCloseParam(curve->nurbs_data, point, NULL);
 }
 
 double nurbs_curve_length(const nurbs_Curve *curve)
 {
-    return 0.0;
+    const nurbs_CurveData *data = curve->nurbs_data;
+    return nurbs__divideLength(data, data->knots[data->degree],
+                               data->knots[data->nknots - data->degree - 1]);
 }
 
 double nurbs_curve_lengthAtParam(const nurbs_Curve *curve, double u)
 {
-    return 0.0;
+    const nurbs_CurveData *data = curve->nurbs_data;
+    return nurbs__divideLength(data, data->knots[data->degree], u);
 }
 
 double nurbs_curve_paramAtLength(const nurbs_Curve *curve, double len)
 {
-    return 0.0;
+    return nurbs__divideParamAtLength(curve->nurbs_data, len);
 }
 
 int nurbs_curve_divideByEqualArcLength(const nurbs_Curve *curve, int divisions,
                                        nurbs_CurveSample **samples, int *ns)
 {
-    return 0;
+    if (divisions <= 0)
+        return NURBS_FALSE;
+
+    nurbs_CurveSample *s = (nurbs_CurveSample *)nurbs__memAlloc(
+        ((size_t)divisions + 1) * sizeof(nurbs_CurveSample));
+    if (s == NULL)
+        return NURBS_FALSE;
+
+    nurbs__Out out;
+    nurbs__outInit(&out, s, sizeof(nurbs_CurveSample), 0, (size_t)divisions + 1);
+    if (!nurbs__divideEqualArcLength(curve->nurbs_data, (size_t)divisions,
+                                     &out)) {
+        nurbs__memFree(s);
+        return NURBS_FALSE;
+    }
+    *samples = s;
+    *ns = divisions + 1;
+    return NURBS_TRUE;
+}
+
+size_t nurbs_curve_divideByEqualArcLength_into(const nurbs_Curve *curve,
+                                               size_t divisions,
+                                               nurbs_CurveSample *samples,
+                                               size_t first, size_t cap)
+{
+    nurbs__Out out;
+    nurbs__outInit(&out, samples, sizeof(nurbs_CurveSample), first, cap);
+    if (!nurbs__divideEqualArcLength(curve->nurbs_data, divisions, &out))
+        return 0;
+    return out.count;
 }
 
 int nurbs_curve_divideByArcLength(const nurbs_Curve *curve, double arclength,
                                   nurbs_CurveSample **samples, int *ns)
 {
-    return 0;
+    nurbs__Out out;
+    nurbs__outInit(&out, NULL, sizeof(nurbs_CurveSample), 0, 0);
+    if (!nurbs__divideArcLength(curve->nurbs_data, arclength, &out) ||
+        out.count > INT_MAX)
+        return NURBS_FALSE;
+
+    size_t n = out.count;
+    nurbs_CurveSample *s =
+        (nurbs_CurveSample *)nurbs__memAlloc(n * sizeof(nurbs_CurveSample));
+    if (s == NULL)
+        return NURBS_FALSE;
+
+    nurbs__outInit(&out, s, sizeof(nurbs_CurveSample), 0, n);
+    if (!nurbs__divideArcLength(curve->nurbs_data, arclength, &out)) {
+        nurbs__memFree(s);
+        return NURBS_FALSE;
+    }
+    *samples = s;
+    *ns = (int)n;
+    return NURBS_TRUE;
+}
+
+size_t nurbs_curve_divideByArcLength_into(const nurbs_Curve *curve,
+                                          double arclength,
+                                          nurbs_CurveSample *samples,
+                                          size_t first, size_t cap)
+{
+    nurbs__Out out;
+    nurbs__outInit(&out, samples, sizeof(nurbs_CurveSample), first, cap);
+    if (!nurbs__divideArcLength(curve->nurbs_data, arclength, &out))
+        return 0;
+    return out.count;
 }
 
 int nurbs_curve_split(const nurbs_Curve *curve, double u, nurbs_Curve **curves,
                       int *nc)
 {
-    return 0;
+    if (!nurbs__divideSplitAlloc(curve->nurbs_data, u, curves))
+        return NURBS_FALSE;
+    *nc = 2;
+    return NURBS_TRUE;
+}
+
+size_t nurbs_curve_split_into(const nurbs_Curve *curve, double u, void *buffer,
+                              size_t size, nurbs_Curve *curves[2])
+{
+    size_t nleft, nright;
+    size_t need = nurbs__divideSplitSize(curve->nurbs_data, u,
+                                         sizeof(nurbs_Curve), &nleft, &nright);
+    if (need == 0)
+        return 0;
+    /* room to align the start of the buffer */
+    need += NURBS__ALIGN - 1;
+    if (buffer == NULL || size < need)
+        return need;
+
+    uintptr_t mem = ((uintptr_t)buffer + NURBS__ALIGN - 1) &
+                    ~(uintptr_t)(NURBS__ALIGN - 1);
+    nurbs__divideSplit(curve->nurbs_data, u, (void *)mem, curves);
+    return need;
 }
 
 int nurbs_curve_tessellate(const nurbs_Curve *curve, double tol,
                            nurbs_Point **points, int *np)
 {
-    return 0;
+    nurbs_TessTolerance t = {tol, 0.0};
+    return nurbs_curve_tessellate_tol(curve, &t, points, np);
+}
+
+size_t nurbs_curve_tessellate_into(const nurbs_Curve *curve, double tol,
+                                   nurbs_Point *points, size_t first,
+                                   size_t cap)
+{
+    nurbs_TessTolerance t = {tol, 0.0};
+    return nurbs_curve_tessellate_tol_into(curve, &t, points, first, cap);
+}
+
+int nurbs_curve_tessellate_tol(const nurbs_Curve *curve,
+                               const nurbs_TessTolerance *tol,
+                               nurbs_Point **points, int *np)
+{
+    nurbs__Out out;
+    nurbs__outInit(&out, NULL, sizeof(nurbs_Point), 0, 0);
+    if (!nurbs__tessCurve(curve->nurbs_data, tol, &out) || out.count > INT_MAX)
+        return NURBS_FALSE;
+
+    size_t n = out.count;
+    nurbs_Point *pts = (nurbs_Point *)nurbs__memAlloc(n * sizeof(nurbs_Point));
+    if (pts == NULL)
+        return NURBS_FALSE;
+
+    nurbs__outInit(&out, pts, sizeof(nurbs_Point), 0, n);
+    if (!nurbs__tessCurve(curve->nurbs_data, tol, &out)) {
+        nurbs__memFree(pts);
+        return NURBS_FALSE;
+    }
+    *points = pts;
+    *np = (int)n;
+    return NURBS_TRUE;
+}
+
+size_t nurbs_curve_tessellate_tol_into(const nurbs_Curve *curve,
+                                       const nurbs_TessTolerance *tol,
+                                       nurbs_Point *points, size_t first,
+                                       size_t cap)
+{
+    nurbs__Out out;
+    nurbs__outInit(&out, points, sizeof(nurbs_Point), first, cap);
+    if (!nurbs__tessCurve(curve->nurbs_data, tol, &out))
+        return 0;
+    return out.count;
+}
+
+int nurbs_curve_tessellate_clip(const nurbs_Curve *curve,
+                                const nurbs_TessTolerance *tol,
+                                const nurbs_ClipRegion *clip,
+                                nurbs_Point **points, size_t **offsets,
+                                size_t *nruns)
+{
+    nurbs__Out out, runs;
+    nurbs__outInit(&out, NULL, sizeof(nurbs_Point), 0, 0);
+    nurbs__outInit(&runs, NULL, sizeof(size_t), 0, 0);
+    if (!nurbs__tessClip(curve->nurbs_data, tol, clip, &out, &runs))
+        return NURBS_FALSE;
+
+    size_t n = out.count, nr = runs.count;
+    nurbs_Point *pts =
+        (nurbs_Point *)nurbs__memAlloc((n ? n : 1) * sizeof(nurbs_Point));
+    size_t *offs = (size_t *)nurbs__memAlloc(nr * sizeof(size_t));
+    if (pts == NULL || offs == NULL)
+        goto fail;
+
+    nurbs__outInit(&out, pts, sizeof(nurbs_Point), 0, n);
+    nurbs__outInit(&runs, offs, sizeof(size_t), 0, nr);
+    if (!nurbs__tessClip(curve->nurbs_data, tol, clip, &out, &runs))
+        goto fail;
+    *points = pts;
+    *offsets = offs;
+    *nruns = nr - 1;
+    return NURBS_TRUE;
+
+fail:
+    nurbs__memFree(pts);
+    nurbs__memFree(offs);
+    return NURBS_FALSE;
+}
+
+nurbs_TessIterator *nurbs_tessiter_new(const nurbs_Curve *curve,
+                                       const nurbs_TessTolerance *tol)
+{
+    return nurbs__tessIterNew(curve->nurbs_data, tol);
+}
+
+int nurbs_tessiter_next(nurbs_TessIterator *it, nurbs_Point *points,
+                        size_t cap, size_t *n)
+{
+    return nurbs__tessIterNext(it, points, cap, n);
+}
+
+void nurbs_tessiter_free(nurbs_TessIterator *it)
+{
+    nurbs__tessIterFree(it);
+}
+
+nurbs_Tessellation *nurbs_tessellation_new(const nurbs_Curve *curve,
+                                           const nurbs_TessTolerance *tol)
+{
+    return nurbs__tessResultNew(curve->nurbs_data, tol);
+}
+
+int nurbs_tessellation_update(nurbs_Tessellation *t, size_t first, size_t n,
+                              size_t *span0, size_t *span1)
+{
+    return nurbs__tessResultUpdate(t, first, n, span0, span1);
+}
+
+size_t nurbs_tessellation_nspans(const nurbs_Tessellation *t)
+{
+    return nurbs__tessResultSpans(t);
+}
+
+const nurbs_Point *nurbs_tessellation_span(const nurbs_Tessellation *t,
+                                           size_t span, size_t *n)
+{
+    return nurbs__tessResultSpan(t, span, n);
+}
+
+size_t nurbs_tessellation_points_into(const nurbs_Tessellation *t,
+                                      nurbs_Point *points, size_t first,
+                                      size_t cap)
+{
+    return nurbs__tessResultPoints(t, points, first, cap);
+}
+
+void nurbs_tessellation_free(nurbs_Tessellation *t)
+{
+    nurbs__tessResultFree(t);
+}
+
+nurbs_TessCache *nurbs_tesscache_new(size_t budget)
+{
+    return nurbs__cacheNew(budget);
+}
+
+const nurbs_Point *nurbs_tesscache_get(nurbs_TessCache *cache,
+                                       const nurbs_Curve *curve, double tol,
+                                       size_t *n)
+{
+    return nurbs__cacheGet(cache, curve, tol, n);
+}
+
+void nurbs_tesscache_invalidate(nurbs_TessCache *cache,
+                                const nurbs_Curve *curve)
+{
+    nurbs__cacheInvalidate(cache, curve);
+}
+
+void nurbs_tesscache_set_budget(nurbs_TessCache *cache, size_t budget)
+{
+    nurbs__cacheSetBudget(cache, budget);
+}
+
+void nurbs_tesscache_stats(const nurbs_TessCache *cache,
+                           nurbs_TessCacheStats *stats)
+{
+    nurbs__cacheStats(cache, stats);
+}
+
+void nurbs_tesscache_free(nurbs_TessCache *cache)
+{
+    nurbs__cacheFree(cache);
+}
+
+int nurbs_curves_tessellate(const nurbs_Curve *const *curves, size_t n,
+                            const nurbs_TessTolerance *tol, unsigned nthreads,
+                            nurbs_Point **points, size_t **offsets)
+{
+    return nurbs__batchTessellate(curves, n, tol, nthreads, points, offsets);
 }
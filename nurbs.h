@@ -30,9 +30,18 @@ extern "C" {
 #include <stdint.h>
 #include <stddef.h>
 
+#if defined(_MSC_VER)
+#define NURBS_ALIGN(n) __declspec(align(n))
+#else
+#define NURBS_ALIGN(n) __attribute__((aligned(n)))
+#endif
+
 #define NURBS_TRUE                1
 #define NURBS_FALSE               0
 
+#define NURBS_MAXDEGREE           31 /* highest supported curve degree */
+
+#define NURBS_CURVE_NURBS         0 /* general curve, no analytic form */
 #define NURBS_CURVE_ARC           1
 #define NURBS_CURVE_BEZIER        2
 #define NURBS_CURVE_CIRCLE        3
@@ -54,9 +63,23 @@ typedef struct {
 } nurbs_Vector, nurbs_Point;
 
 typedef struct {
-    size_t npoints;      /* number of control vertex */
-    nurbs_Point *points; /* array of control vertex */
-    double *weights;     /* array of weights */
+    double x; /* w * x */
+    double y; /* w * y */
+    double z; /* w * z */
+    double w; /* weight */
+} nurbs_HPoint; /* homogeneous point */
+
+/*
+ control vertices stored packed as homogeneous (wx, wy, wz, w) quads, one
+ 32 byte aligned stream, so a rational evaluation reads a single array and
+ each control vertex fills one 256 bit register. Use nurbs_new_curve_withKCW
+ and nurbs_curve_controlpoints to convert from and to points and weights.
+ This is an API break: the former points and weights members are gone, code
+ that read them directly has to go through nurbs_curve_controlpoints.
+*/
+typedef struct {
+    size_t npoints;        /* number of control vertex */
+    nurbs_HPoint *hpoints; /* array of homogeneous control vertex */
 } nurbs_PointArray;
 
 typedef struct {
@@ -74,6 +97,8 @@ typedef struct {
     uint32_t nknots;      /* number of nondecreasing knot values */
     double *knots;        /* array of nondecreasing knot values */
     nurbs_PointArray *cv; /* control vertex */
+    struct nurbs__KnotIndex *kindex; /* span lookup table, built lazily
+                                        by the library, NULL until then */
 } nurbs_CurveData;
 
 typedef struct {
@@ -112,11 +137,130 @@ typedef struct {
 */
 typedef double *nurbs_Matrix;
 
+/*
+ 4x4 transformation matrix, row major, applied to column vectors as
+ p' = m * (x, y, z, 1). Affine matrices have 0 0 0 1 as last row, anything
+ else is treated as a projective transformation. The type is 32 byte aligned,
+ heap allocations must honour that.
+*/
+typedef struct NURBS_ALIGN(32) {
+    double m[4][4];
+} nurbs_Matrix4;
+
 typedef struct {
     double u;
     double len;
 } nurbs_CurveSample;
 
+/*
+ tessellation tolerances, see nurbs_curve_tessellate_tol. chord bounds the
+ distance between the curve and its polyline. angle, when positive, bounds
+ the angle between each polyline segment and the curve tangent along it.
+*/
+typedef struct {
+    double chord; /* chord height tolerance, positive */
+    double angle; /* angular tolerance in radians, 0 for none */
+} nurbs_TessTolerance;
+
+/*
+ clip region of nurbs_curve_tessellate_clip, the points on the side of every
+ plane its normal points to, dot(normal, p - origin) >= 0. Four planes make
+ a 2d window, six an axis aligned box or a view frustum.
+*/
+typedef struct {
+    const nurbs_Plane *planes; /* planes, normals pointing inwards */
+    size_t nplanes;            /* number of planes */
+} nurbs_ClipRegion;
+
+/*
+ memory callbacks, see nurbs_set_allocator. alloc returns size bytes aligned
+ to align, a power of two, or NULL. realloc may be NULL, the library then
+ moves blocks with alloc and free. Sizes given to realloc and free are the
+ ones the block was allocated with, so arenas and tracking allocators need
+ no bookkeeping of their own.
+*/
+typedef struct {
+    void *(*alloc)(void *user, size_t size, size_t align);
+    void *(*realloc)(void *user, void *ptr, size_t oldsize, size_t size,
+                     size_t align);
+    void (*free)(void *user, void *ptr, size_t size);
+    void *user; /* passed back to the callbacks */
+} nurbs_Allocator;
+
+/* streaming least squares fitter, see nurbs_fitter_new */
+typedef struct nurbs__CurveFitter nurbs_CurveFitter;
+
+/* pull based adaptive tessellation, see nurbs_tessiter_new */
+typedef struct nurbs__TessIter nurbs_TessIterator;
+
+/* tessellation kept up to date under edits, see nurbs_tessellation_new */
+typedef struct nurbs__Tessellation nurbs_Tessellation;
+
+/* tessellations of many curves at several tolerances, see nurbs_tesscache_new */
+typedef struct nurbs__TessCache nurbs_TessCache;
+
+typedef struct {
+    size_t hits;      /* requests served from the cache */
+    size_t derived;   /* requests served by simplifying a finer level */
+    size_t misses;    /* requests that tessellated the curve */
+    size_t evictions; /* entries dropped to stay within the budget */
+    size_t entries;   /* entries in the cache */
+    size_t bytes;     /* bytes held by the entries */
+} nurbs_TessCacheStats;
+
+/*
+ collection of curves kept in a few shared pools, see nurbs_store_new. Curves
+ are addressed by handles, which stay valid until the curve is removed, or
+ by their index in memory order, which changes when curves before them are
+ removed. Handle 0 never refers to a curve.
+*/
+typedef struct nurbs__CurveStore nurbs_CurveStore;
+typedef uint64_t nurbs_CurveHandle;
+
+#define NURBS_HANDLE_NONE ((nurbs_CurveHandle)0)
+
+/*
+ read-only compiled form of a curve, built by nurbs_curve_compile. Each non
+ empty knot span [breaks[i], breaks[i + 1]) is stored as a polynomial in the
+ local parameter t = (u - breaks[i]) / (breaks[i + 1] - breaks[i]) with
+ homogeneous (wx, wy, wz, w) coefficients, lowest order first.
+*/
+typedef struct {
+    uint8_t degree;  /* degree of curve */
+    uint32_t nspans; /* number of non empty knot spans */
+    double *breaks;  /* nspans + 1 span boundaries */
+    double *coeffs;  /* nspans * (degree + 1) * 4 power basis coefficients */
+} nurbs_CompiledCurve;
+
+/*
+ single precision variant of nurbs_CompiledCurve for display, built by
+ nurbs_curve_compilef. The coefficients are float and taken relative to
+ origin, the center of the control point bounding box, so the rounding error
+ scales with the size of the curve and not with its distance from zero. The
+ vertices it outputs are relative to origin as well.
+*/
+typedef struct {
+    uint8_t degree;     /* degree of curve */
+    uint32_t nspans;    /* number of non empty knot spans */
+    nurbs_Point origin; /* offset of the coefficients and output vertices */
+    double error;       /* bound on the distance to the double evaluation */
+    double *breaks;     /* nspans + 1 span boundaries */
+    float *coeffs;      /* nspans * (degree + 1) * 4 power basis coefficients */
+} nurbs_CompiledCurveF;
+
+/*
+ cursor for monotone parameter sweeps, see nurbs_cursor_init. It keeps the
+ current knot span and the basis functions of the last parameter, so moving
+ to a nearby parameter does not search the knot vector again.
+*/
+typedef struct {
+    const nurbs_CurveData *data;    /* curve the cursor is bound to */
+    size_t span;                    /* current knot span */
+    double u;                       /* parameter of the cached basis */
+    double N[NURBS_MAXDEGREE + 1];  /* basis functions at u */
+    double dN[NURBS_MAXDEGREE + 1]; /* first derivatives of the basis at u */
+} nurbs_CurveCursor;
+
 /* Nurbs shapes */
 
 #define GEOM_NURBS_DATA \
@@ -162,6 +306,18 @@ typedef struct {
 
 
 
+/*
+ a stored curve seen as a general curve: curve.type is NURBS_CURVE_NURBS and
+ the arrays point into the store pools. Pass &view.curve to the read-only
+ curve API, never to nurbs_free. A view is valid until the next append or
+ remove on its store.
+*/
+typedef struct {
+    nurbs_Curve curve;
+    nurbs_CurveData data;
+    nurbs_PointArray cv;
+} nurbs_CurveView;
+
 #ifdef __cplusplus
 }
 #endif
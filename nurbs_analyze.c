@@ -20,4 +20,109 @@
  * IN THE SOFTWARE.
  */
 
-#include "nurbs_internal.h"
\ No newline at end of file
+#include "nurbs_internal.h"
+#include <math.h>
+
+#define NURBS__CLOSEITERS 32
+
+/* squared distance to the point, with f = C'.(C - P), half its derivative,
+ * and the derivative of f */
+static double nurbs__analyzeNewtonStep(const nurbs_CurveData *data,
+                                       const nurbs_Point *point, double u,
+                                       double *f, double *df)
+{
+    nurbs_Vector ck[3];
+    nurbs__evalCurveDerivatives(data, u, 2, ck);
+    nurbs_Vector d = nurbs__vecSub(ck[0], *point);
+    *f = nurbs__vecDot(ck[1], d);
+    *df = nurbs__vecDot(ck[2], d) + nurbs__vecDot(ck[1], ck[1]);
+    return nurbs__vecDot(d, d);
+}
+
+double nurbs__analyzeCloseParam(const nurbs_CurveData *data,
+                                const nurbs_Point *point, nurbs_Point *closest)
+{
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+    size_t nper = 2 * (p + 1);
+
+    size_t nspans = 0;
+    for (size_t k = p; k <= last; ++k)
+        nspans += U[k] < U[k + 1];
+    size_t ns = nspans * nper + 1;
+
+    /* coarse pass over evenly spaced samples of every span, batched */
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    double *us = (double *)nurbs__memScratchAlloc(5 * ns * sizeof(double));
+    if (us == NULL)
+        return NAN;
+    double *x = us + ns, *y = x + ns, *z = y + ns, *d2 = z + ns;
+
+    size_t i = 0;
+    for (size_t k = p; k <= last; ++k) {
+        if (U[k] >= U[k + 1])
+            continue;
+        double h = (U[k + 1] - U[k]) / (double)nper;
+        for (size_t j = 0; j < nper; ++j)
+            us[i++] = U[k] + (double)j * h;
+    }
+    us[i] = U[last + 1];
+
+    if (!nurbs__evalCurvePoints(data, us, ns, x, y, z)) {
+        nurbs__memScratchRelease(mark);
+        return NAN;
+    }
+
+    nurbs__kernels()->distSquared(x, y, z, ns, *point, d2);
+    size_t best = 0;
+    double dbest = INFINITY;
+    for (i = 0; i < ns; ++i) {
+        if (d2[i] < dbest) {
+            dbest = d2[i];
+            best = i;
+        }
+    }
+
+    /* Newton on C'.(C - P) = 0, kept inside the neighbouring samples */
+    double lo = us[best > 0 ? best - 1 : 0];
+    double hi = us[best + 1 < ns ? best + 1 : ns - 1];
+    double u = us[best], ubest = u;
+    double dsample = dbest;
+    nurbs__memScratchRelease(mark);
+
+    int converged = 0;
+    for (int it = 0; it < NURBS__CLOSEITERS; ++it) {
+        double f, df;
+        double d = nurbs__analyzeNewtonStep(data, point, u, &f, &df);
+        if (d < dbest) {
+            dbest = d;
+            ubest = u;
+        }
+        if (d <= NURBS__EPSILON * NURBS__EPSILON) {
+            converged = d <= dsample;
+            break;
+        }
+        if (df <= 0.0)
+            break;
+        double un = u - f / df;
+        if (un < lo)
+            un = lo;
+        else if (un > hi)
+            un = hi;
+        double du = fabs(un - u);
+        u = un;
+        if (du <= NURBS__EPSILON * (hi - lo)) {
+            converged = d <= dsample;
+            break;
+        }
+    }
+    /* the distance is flat at the minimum, so the converged iterate beats a
+       slightly smaller rounded distance elsewhere */
+    if (converged)
+        ubest = u;
+
+    if (closest != NULL)
+        *closest = nurbs__evalCurvePoint(data, ubest);
+    return ubest;
+}
@@ -29,6 +29,40 @@ extern "C" {
 
 #include "nurbs.h"
 
+/**
+ * route all library allocations through an allocator.  Every block remembers
+ * the allocator it came from and goes back to it, so objects may outlive a
+ * switch, but the allocator struct must stay valid until they are freed.
+ * Not thread safe, set it before creating objects
+ * \p allocator allocator, NULL restores malloc and free
+ */
+void nurbs_set_allocator(const nurbs_Allocator *allocator);
+
+/**
+ * override the global allocator on the calling thread only, e.g. with a per
+ * request arena whose memory is dropped at once when the request is done.
+ * The scratch arena is kept across requests and always takes its memory
+ * from the global allocator
+ * \p allocator allocator, NULL falls back to the global one
+ * \return the previous thread allocator, to restore nested overrides
+ */
+const nurbs_Allocator *nurbs_set_thread_allocator(
+    const nurbs_Allocator *allocator);
+
+/**
+ * free the temporary memory the library keeps cached on the calling thread.
+ * Algorithms take their work buffers from a per thread scratch arena that
+ * grows to the largest size needed and is then reused, call this before a
+ * thread exits or after an unusually large job
+ */
+void nurbs_scratch_trim(void);
+
+/**
+ * free an array returned by the library, e.g. by nurbs_curve_derivatives
+ * \p buffer array, may be NULL
+ */
+void nurbs_free_buffer(void *buffer);
+
 /**
  * free nurbs curve
  * \p curve curve object
@@ -42,26 +76,280 @@ void nurbs_free(nurbs_Curve *curve);
  * \p ncv number of control vertex
  * \p knots nondecreasing knot values
  * \p nknots number of nondecreasing knot values
- * \p weights weights of control vertex
+ * \p weights weights of control vertex, NULL for a non rational curve
  * \p nweights number of weights
- * \return nurbs curve object
+ * \return nurbs curve object, NULL if the sizes do not match
  */
 nurbs_Curve *nurbs_new_curve_withKCW(uint8_t degree, const nurbs_Point *cv,
                                      uint32_t ncv, double *knots,
                                      uint32_t nknots, double *weights,
                                      uint32_t nweights);
 
+/**
+ * copy the control points of a curve out as cartesian points and weights
+ * \p curve curve object
+ * \p points array of npoints control points to fill (optional)
+ * \p weights array of npoints weights to fill (optional)
+ * \return number of control points
+ */
+size_t nurbs_curve_controlpoints(const nurbs_Curve *curve, nurbs_Point *points,
+                                 double *weights);
+
 /**
  * construct a NurbsCurve by interpolating a collection of points.  The
- * resultant curve will pass through all of the points.
- * \p cv control vertex
- * \p ncv number of control vertex
+ * resultant curve will pass through all of the points, with chord length
+ * parametrization.  Runs in O(ncv * degree^2) time and O(ncv * degree) memory
+ * \p cv points to interpolate
+ * \p ncv number of points, greater than degree
  * \p degree degree of curve
- * \return nurbs curve object
+ * \return nurbs curve object, NULL if the points are degenerate
  */
 nurbs_Curve *nurbs_new_curve_withP(const nurbs_Point *cv, uint32_t ncv,
                                    uint8_t degree);
 
+/**
+ * overwrite some control points of a curve in place.  The knots are left
+ * as they are.  A curve of another type becomes NURBS_CURVE_NURBS
+ * \p curve curve object
+ * \p first index of the first control point to overwrite
+ * \p points n new control points
+ * \p weights n new positive weights, NULL keeps the current ones
+ * \p n number of control points to overwrite
+ * \return NURBS_TRUE, NURBS_FALSE if the points run past the last control
+ * point or a weight is not positive, the curve is then unchanged
+ */
+int nurbs_curve_set_controlpoints(nurbs_Curve *curve, size_t first,
+                                  const nurbs_Point *points,
+                                  const double *weights, size_t n);
+
+/**
+ * create a least squares fitter for a curve with ncv control points and
+ * uniform knots over [umin, umax].  Samples are fed in any number of batches
+ * with nurbs_fitter_add and never stored, memory is O(ncv * degree)
+ * regardless of the number of samples
+ * \p degree degree of curve
+ * \p ncv number of control points, greater than degree, the most a fit to a
+ * tolerance may use.  The tolerance fit picks among segment counts dividing
+ * ncv - degree, so a count with many divisors offers the finest choice
+ * \p umin domain start
+ * \p umax domain end
+ * \return fitter object, release it with nurbs_fitter_free
+ */
+nurbs_CurveFitter *nurbs_fitter_new(uint8_t degree, uint32_t ncv, double umin,
+                                    double umax);
+
+/**
+ * feed samples to a fitter.  Each point comes with its curve parameter, e.g.
+ * accumulated chord length or scan time, parameters outside the domain are
+ * clamped
+ * \p fitter fitter object
+ * \p points sample points
+ * \p us sample parameters
+ * \p n number of samples
+ */
+void nurbs_fitter_add(nurbs_CurveFitter *fitter, const nurbs_Point *points,
+                      const double *us, size_t n);
+
+/**
+ * solve for the curve minimizing the squared distances to the samples fed
+ * so far.  The fitter is left unchanged and may be fed further
+ * \p fitter fitter object
+ * \p rms root mean square residual of the samples (optional)
+ * \return nurbs curve object, NULL without samples or out of memory
+ */
+nurbs_Curve *nurbs_fitter_curve(const nurbs_CurveFitter *fitter, double *rms);
+
+/**
+ * solve for the curve with the fewest control points whose root mean square
+ * residual is within a tolerance.  Candidates have uniform knots with a
+ * number of segments dividing that of the fitter, their fits come from the
+ * accumulated sums, so the samples are not needed again.  If none meets the
+ * tolerance the fit with all ncv control points is returned and rms tells
+ * \p fitter fitter object
+ * \p tol root mean square residual to meet, positive
+ * \p rms root mean square residual of the result (optional)
+ * \return nurbs curve object, NULL without samples, if tol is not positive or
+ * out of memory
+ */
+nurbs_Curve *nurbs_fitter_curve_tol(const nurbs_CurveFitter *fitter,
+                                    double tol, double *rms);
+
+/**
+ * free a fitter
+ * \p fitter fitter object
+ */
+void nurbs_fitter_free(nurbs_CurveFitter *fitter);
+
+/**
+ * create a curve store.  Knots, control points and curve headers of all
+ * curves live in three contiguous pools, so bulk passes over a drawing walk
+ * memory linearly and the whole drawing serializes as a few blocks.  The
+ * sizes only reserve room, the pools grow as needed
+ * \p ncurves expected number of curves
+ * \p nknots expected total number of knot values
+ * \p npoints expected total number of control points
+ * \return store object, release it with nurbs_store_free
+ */
+nurbs_CurveStore *nurbs_store_new(size_t ncurves, size_t nknots,
+                                  size_t npoints);
+
+/**
+ * free a curve store and all curves in it
+ * \p store store object
+ */
+void nurbs_store_free(nurbs_CurveStore *store);
+
+/**
+ * append copies of curves at the end of the store, in order
+ * \p store store object
+ * \p curves array of curves
+ * \p n number of curves
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory, the store is then
+ * unchanged
+ */
+int nurbs_store_append(nurbs_CurveStore *store, const nurbs_Curve *const *curves,
+                       size_t n, nurbs_CurveHandle *handles);
+
+/**
+ * remove curves from the store in one pass.  The remaining curves keep their
+ * handles and their relative order
+ * \p store store object
+ * \p handles array of handles, stale or repeated ones are ignored
+ * \p n number of handles
+ * \return number of curves removed
+ */
+size_t nurbs_store_remove(nurbs_CurveStore *store,
+                          const nurbs_CurveHandle *handles, size_t n);
+
+/**
+ * number of curves in the store
+ * \p store store object
+ */
+size_t nurbs_store_count(const nurbs_CurveStore *store);
+
+/**
+ * handle of the curve at an index in memory order
+ * \p store store object
+ * \p index index below nurbs_store_count
+ */
+nurbs_CurveHandle nurbs_store_handle(const nurbs_CurveStore *store,
+                                     size_t index);
+
+/**
+ * index in memory order of the curve a handle refers to
+ * \p store store object
+ * \p handle curve handle
+ * \p index index to fill
+ * \return NURBS_TRUE, NURBS_FALSE if the curve was removed
+ */
+int nurbs_store_index(const nurbs_CurveStore *store, nurbs_CurveHandle handle,
+                      size_t *index);
+
+/**
+ * type the curve had when it was appended, one of NURBS_CURVE_*
+ * \p store store object
+ * \p index index below nurbs_store_count
+ */
+int nurbs_store_type(const nurbs_CurveStore *store, size_t index);
+
+/**
+ * view the curve at an index in memory order.  Iterate a store with
+ * nurbs_store_view for index 0 to nurbs_store_count - 1
+ * \p store store object
+ * \p index index below nurbs_store_count
+ * \p view view to fill, use &view->curve with the curve API
+ */
+void nurbs_store_view(const nurbs_CurveStore *store, size_t index,
+                      nurbs_CurveView *view);
+
+/**
+ * append arcs to a store, the bulk form of nurbs_new_arc.  All curve data
+ * goes straight into the store pools, reserved once for the whole batch
+ * \p store store object
+ * \p centers array of n centers
+ * \p xaxes array of n xaxes
+ * \p yaxes array of n perpendicular yaxes
+ * \p radii array of n radii
+ * \p minAngles array of n start angles in radians
+ * \p maxAngles array of n end angles in radians
+ * \p n number of arcs
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory, the store is then
+ * unchanged
+ */
+int nurbs_store_append_arcs(nurbs_CurveStore *store, const nurbs_Point *centers,
+                            const nurbs_Vector *xaxes,
+                            const nurbs_Vector *yaxes, const double *radii,
+                            const double *minAngles, const double *maxAngles,
+                            size_t n, nurbs_CurveHandle *handles);
+
+/**
+ * append circles to a store, the bulk form of nurbs_new_circle
+ * \p store store object
+ * \p centers array of n centers
+ * \p xaxes array of n xaxes
+ * \p yaxes array of n perpendicular yaxes
+ * \p radii array of n radii
+ * \p n number of circles
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs_store_append_circles(nurbs_CurveStore *store,
+                               const nurbs_Point *centers,
+                               const nurbs_Vector *xaxes,
+                               const nurbs_Vector *yaxes, const double *radii,
+                               size_t n, nurbs_CurveHandle *handles);
+
+/**
+ * append elliptical arcs to a store, the bulk form of nurbs_new_ellipsearc
+ * \p store store object
+ * \p centers array of n centers
+ * \p xaxes array of n xaxes, their lengths are the x radii
+ * \p yaxes array of n perpendicular yaxes, their lengths are the y radii
+ * \p minAngles array of n start angles in radians
+ * \p maxAngles array of n end angles in radians
+ * \p n number of arcs
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs_store_append_ellipsearcs(nurbs_CurveStore *store,
+                                   const nurbs_Point *centers,
+                                   const nurbs_Vector *xaxes,
+                                   const nurbs_Vector *yaxes,
+                                   const double *minAngles,
+                                   const double *maxAngles, size_t n,
+                                   nurbs_CurveHandle *handles);
+
+/**
+ * append ellipses to a store, the bulk form of nurbs_new_ellipse
+ * \p store store object
+ * \p centers array of n centers
+ * \p xaxes array of n xaxes, their lengths are the x radii
+ * \p yaxes array of n perpendicular yaxes, their lengths are the y radii
+ * \p n number of ellipses
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs_store_append_ellipses(nurbs_CurveStore *store,
+                                const nurbs_Point *centers,
+                                const nurbs_Vector *xaxes,
+                                const nurbs_Vector *yaxes, size_t n,
+                                nurbs_CurveHandle *handles);
+
+/**
+ * append lines to a store, the bulk form of nurbs_new_line
+ * \p store store object
+ * \p starts array of n start points
+ * \p ends array of n end points
+ * \p n number of lines
+ * \p handles array of n handles to fill (optional)
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs_store_append_lines(nurbs_CurveStore *store, const nurbs_Point *starts,
+                             const nurbs_Point *ends, size_t n,
+                             nurbs_CurveHandle *handles);
+
 /**
  * constructor for Arc
  * \p center Length center of the arc
@@ -148,13 +436,64 @@ nurbs_Curve *nurbs_curve_reverse(const nurbs_Curve *curve);
 void nurbs_curve_domain(const nurbs_Curve *curve, double *min, double *max);
 
 /**
- * transform a curve with the given matrix.
+ * transform a curve with the given matrix.  The result is a new general
+ * curve of type NURBS_CURVE_NURBS
  * \p curve origion curve
  * \p matrix 4x4 transformation matrix
- * \return
+ * \return transformed curve, NULL if out of memory
  */
 nurbs_Curve *nurbs_curve_transform(const nurbs_Curve *curve,
-                                   nurbs_Matrix matrix);
+                                   const nurbs_Matrix4 *matrix);
+
+/**
+ * transform a curve in place, without reallocating it.  Arcs, circles,
+ * ellipses keep their type under rigid motions and lines under any affine
+ * matrix, otherwise the curve becomes NURBS_CURVE_NURBS
+ * \p curve curve object
+ * \p matrix 4x4 transformation matrix
+ */
+void nurbs_curve_transform_inplace(nurbs_Curve *curve,
+                                   const nurbs_Matrix4 *matrix);
+
+/**
+ * set a matrix to identity
+ * \p m matrix to set
+ */
+void nurbs_matrix_identity(nurbs_Matrix4 *m);
+
+/**
+ * set a matrix to a translation
+ * \p m matrix to set
+ * \p v translation vector
+ */
+void nurbs_matrix_translation(nurbs_Matrix4 *m, const nurbs_Vector *v);
+
+/**
+ * set a matrix to a rotation around an axis
+ * \p m matrix to set
+ * \p origin point on the rotation axis
+ * \p axis direction of the rotation axis
+ * \p angle rotation angle in radians, counterclockwise around axis
+ */
+void nurbs_matrix_rotation(nurbs_Matrix4 *m, const nurbs_Point *origin,
+                           const nurbs_Vector *axis, double angle);
+
+/**
+ * compose two matrices, r = a * b applies b first.  r may alias a or b
+ * \p a left matrix
+ * \p b right matrix
+ * \p r result matrix
+ */
+void nurbs_matrix_compose(const nurbs_Matrix4 *a, const nurbs_Matrix4 *b,
+                          nurbs_Matrix4 *r);
+
+/**
+ * invert a matrix.  r may alias m
+ * \p m matrix to invert
+ * \p r result matrix
+ * \return NURBS_FALSE if m is singular
+ */
+int nurbs_matrix_invert(const nurbs_Matrix4 *m, nurbs_Matrix4 *r);
 
 /**
  * sample a point at the given parameter
@@ -164,6 +503,20 @@ nurbs_Curve *nurbs_curve_transform(const nurbs_Curve *curve,
  */
 nurbs_Point nurbs_curve_point(const nurbs_Curve *curve, double u);
 
+/**
+ * sample points at many parameters at once.  The parameters may be sorted or
+ * unsorted, sorted input avoids the knot span search entirely
+ * \p curve curve object
+ * \p us array of parameters
+ * \p n number of parameters
+ * \p x array of n x coordinates to fill
+ * \p y array of n y coordinates to fill
+ * \p z array of n z coordinates to fill
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs_curve_points(const nurbs_Curve *curve, const double *us, size_t n,
+                       double *x, double *y, double *z);
+
 /**
  * obtain the curve tangent at the given parameter.  This is the first
  * derivative and is not normalized
@@ -177,11 +530,131 @@ nurbs_Vector nurbs_curve_tangent(const nurbs_Curve *curve, double u);
  * \param curve curve object
  * \param u parameter
  * \param nderives number of derivatives to obtain
- * \param v array of vectors to store the derivatives
+ * \param v array of vectors to store the derivatives, release it with
+ * nurbs_free_buffer
  * \param nv number of vectors in the array
  */
 int nurbs_curve_derivatives(const nurbs_Curve *curve, double u, int nderives,
                             nurbs_Vector **v, int *nv);
+
+/**
+ * get derivatives at a given parameter into a caller buffer.  Like all _into
+ * functions it stores elements [first, first + cap) of the full result in the
+ * buffer and returns the full element count, so a NULL buffer or a cap of 0
+ * queries the size and a truncated result continues by advancing first.
+ * The buffer may be mapped GPU or file memory.  A window that does not start
+ * at 0 or is shorter than the result is derived in scratch memory first
+ * \p curve curve object
+ * \p u parameter
+ * \p nderives number of derivatives to obtain
+ * \p v buffer for cap vectors, may be NULL
+ * \p first index of the first vector to store
+ * \p cap capacity of the buffer in vectors
+ * \return nderives + 1, 0 if out of memory
+ */
+size_t nurbs_curve_derivatives_into(const nurbs_Curve *curve, double u,
+                                    size_t nderives, nurbs_Vector *v,
+                                    size_t first, size_t cap);
+
+/**
+ * bind a cursor to a curve.  The cursor remembers the knot span of the last
+ * parameter, so sweeping the domain in either direction finds each span in
+ * amortized constant time.  The cursor must not outlive the curve
+ * \p cursor cursor to initialize
+ * \p curve curve object
+ */
+void nurbs_cursor_init(nurbs_CurveCursor *cursor, const nurbs_Curve *curve);
+
+/**
+ * sample a point at the given parameter and move the cursor there
+ * \p cursor cursor object
+ * \p u parameter
+ * \return
+ */
+nurbs_Point nurbs_cursor_point(nurbs_CurveCursor *cursor, double u);
+
+/**
+ * obtain the curve tangent at the given parameter and move the cursor there
+ * \p cursor cursor object
+ * \p u parameter
+ */
+nurbs_Vector nurbs_cursor_tangent(nurbs_CurveCursor *cursor, double u);
+
+/**
+ * compile a curve into per span polynomials for repeated evaluation.  The
+ * knot arithmetic is done once here, evaluating the compiled curve is a span
+ * lookup and a Horner scheme
+ * \p curve curve object
+ * \return compiled curve, release it with nurbs_compiled_free; NULL if out of
+ * memory or if all knots of the curve coincide
+ */
+nurbs_CompiledCurve *nurbs_curve_compile(const nurbs_Curve *curve);
+
+/**
+ * free a compiled curve
+ * \p cc compiled curve
+ */
+void nurbs_compiled_free(nurbs_CompiledCurve *cc);
+
+/**
+ * sample a point of a compiled curve at the given parameter
+ * \p cc compiled curve
+ * \p u parameter
+ * \return
+ */
+nurbs_Point nurbs_compiled_point(const nurbs_CompiledCurve *cc, double u);
+
+/**
+ * obtain the tangent of a compiled curve at the given parameter.  This is the
+ * first derivative and is not normalized
+ * \p cc compiled curve
+ * \p u parameter
+ */
+nurbs_Vector nurbs_compiled_tangent(const nurbs_CompiledCurve *cc, double u);
+
+/**
+ * compile a curve into single precision per span polynomials for display.
+ * Half the memory of nurbs_curve_compile, vertices come out as float.  Every
+ * vertex is within cc->error of the double precision curve point minus
+ * cc->origin; the bound is computed per curve from the float rounding of the
+ * coefficients, the local parameter and the Horner scheme, and is typically
+ * around 1e-6 times the size of the curve
+ * \p curve curve object
+ * \return compiled curve, release it with nurbs_compiledf_free; NULL if out
+ * of memory or if all knots of the curve coincide
+ */
+nurbs_CompiledCurveF *nurbs_curve_compilef(const nurbs_Curve *curve);
+
+/**
+ * free a single precision compiled curve
+ * \p cc compiled curve
+ */
+void nurbs_compiledf_free(nurbs_CompiledCurveF *cc);
+
+/**
+ * evaluate a single precision compiled curve at many parameters into an
+ * interleaved xyz float vertex buffer, relative to cc->origin.  Sorted
+ * parameters are cheapest
+ * \p cc compiled curve
+ * \p us array of parameters
+ * \p n number of parameters
+ * \p xyz array of 3 * n floats to fill
+ */
+void nurbs_compiledf_points(const nurbs_CompiledCurveF *cc, const double *us,
+                            size_t n, float *xyz);
+
+/**
+ * tessellate a single precision compiled curve uniformly, nper segments per
+ * knot span, into an interleaved xyz float vertex buffer relative to
+ * cc->origin
+ * \p cc compiled curve
+ * \p nper number of segments per knot span, at least 1
+ * \p xyz array of 3 * (nspans * nper + 1) floats to fill, or NULL
+ * \return number of vertices
+ */
+size_t nurbs_compiledf_sample(const nurbs_CompiledCurveF *cc, uint32_t nper,
+                              float *xyz);
+
 /**
  * determine the closest point on the curve to the given point
  * \p curve curve object
@@ -195,7 +668,8 @@ nurbs_Point nurbs_curve_closepoint(const nurbs_Curve *curve,
  * determine the closest parameter on the curve to the given point
  * \p curve curve object
  * \p point point to find the closest parameter to
- * \return the closest parameter on the curve to the given point
+ * \return the closest parameter on the curve to the given point, NAN if out
+ * of memory
  */
 double nurbs_curve_closeparam(const nurbs_Curve *curve,
                               const nurbs_Point *point);
@@ -228,48 +702,338 @@ double nurbs_curve_paramAtLength(const nurbs_Curve *curve, double len);
  * segments
  * \p curve curve object
  * \p divisions number of divisions
- * \p samples array of samples
+ * \p samples array of divisions + 1 samples, release it with
+ * nurbs_free_buffer
  * \p ns number of samples
- * \return
+ * \return NURBS_TRUE on success, NURBS_FALSE if divisions is not positive or
+ * out of memory
  */
 int nurbs_curve_divideByEqualArcLength(const nurbs_Curve *curve, int divisions,
                                        nurbs_CurveSample **samples, int *ns);
 
+/**
+ * divide the curve into equal arc length segments into a caller buffer, see
+ * nurbs_curve_derivatives_into for first and cap
+ * \p curve curve object
+ * \p divisions number of divisions
+ * \p samples buffer for cap samples, may be NULL
+ * \p first index of the first sample to store
+ * \p cap capacity of the buffer in samples
+ * \return divisions + 1, 0 if divisions is 0 or out of memory
+ */
+size_t nurbs_curve_divideByEqualArcLength_into(const nurbs_Curve *curve,
+                                               size_t divisions,
+                                               nurbs_CurveSample *samples,
+                                               size_t first, size_t cap);
+
 /**
  * given the distance to divide the curve, determine the parameters necessary to
  * divide the curve into equal arc length segments
  *
  * \p curve curve object
  * \p arclength arc length of each segment
- * \p samples array of samples
+ * \p samples array of samples, release it with nurbs_free_buffer
  * \p ns number of samples
- * \return
+ * \return NURBS_TRUE on success, NURBS_FALSE if arclength is not positive or
+ * out of memory
  */
 int nurbs_curve_divideByArcLength(const nurbs_Curve *curve, double arclength,
                                   nurbs_CurveSample **samples, int *ns);
 
+/**
+ * divide the curve into segments of the given arc length into a caller
+ * buffer, see nurbs_curve_derivatives_into for first and cap
+ * \p curve curve object
+ * \p arclength arc length of each segment
+ * \p samples buffer for cap samples, may be NULL
+ * \p first index of the first sample to store
+ * \p cap capacity of the buffer in samples
+ * \return the number of samples, 0 if arclength is not positive or out of
+ * memory
+ */
+size_t nurbs_curve_divideByArcLength_into(const nurbs_Curve *curve,
+                                          double arclength,
+                                          nurbs_CurveSample *samples,
+                                          size_t first, size_t cap);
+
 /**
  * split the curve at the given parameter
  * \p curve curve object
- * \p u parameter
- * \p curves array of curves
+ * \p u parameter, strictly inside the domain
+ * \p curves array of 2 curves, release each with nurbs_free
  * \p nc number of curves
- * \return
+ * \return NURBS_TRUE on success, NURBS_FALSE if u is not inside the domain or
+ * out of memory
  */
 int nurbs_curve_split(const nurbs_Curve *curve, double u, nurbs_Curve **curves,
                       int *nc);
 
 /**
- * tessellate a curve at a given tolerance
+ * split the curve at the given parameter into a caller buffer.  Both curves,
+ * their knots and control points are laid out in the buffer, which must stay
+ * alive as long as they do; do not pass them to nurbs_free
+ * \p curve curve object
+ * \p u parameter, strictly inside the domain
+ * \p buffer buffer of size bytes, may be NULL
+ * \p size size of the buffer in bytes
+ * \p curves set to the left and right curves if the buffer is large enough
+ * \return the bytes needed, 0 if u is not inside the domain
+ */
+size_t nurbs_curve_split_into(const nurbs_Curve *curve, double u, void *buffer,
+                              size_t size, nurbs_Curve *curves[2]);
+
+/**
+ * tessellate a curve at a given chord height tolerance, see
+ * nurbs_curve_tessellate_tol
  * \p curve curve object
  * \p tol tolerance
- * \p points array of points
+ * \p points array of points, release it with nurbs_free_buffer
  * \p np number of points
- * \return
+ * \return NURBS_TRUE on success, NURBS_FALSE if tol is not positive or out of
+ * memory
  */
 int nurbs_curve_tessellate(const nurbs_Curve *curve, double tol,
                            nurbs_Point **points, int *np);
 
+/**
+ * tessellate a curve at a given chord height tolerance into a caller buffer,
+ * see nurbs_curve_derivatives_into for first and cap
+ * \p curve curve object
+ * \p tol tolerance
+ * \p points buffer for cap points, may be NULL
+ * \p first index of the first point to store
+ * \p cap capacity of the buffer in points
+ * \return the number of points, 0 if tol is not positive or out of memory
+ */
+size_t nurbs_curve_tessellate_into(const nurbs_Curve *curve, double tol,
+                                   nurbs_Point *points, size_t first,
+                                   size_t cap);
+
+/**
+ * tessellate a curve adaptively.  Each knot span is subdivided only where
+ * the curve bends, so flat stretches take a single segment and the point
+ * count stays close to the fewest that meet the tolerance.  The polyline
+ * starts and ends at the curve ends and all its points lie on the curve
+ * \p curve curve object
+ * \p tol chord height and optional angular tolerance
+ * \p points array of points, release it with nurbs_free_buffer
+ * \p np number of points
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs_curve_tessellate_tol(const nurbs_Curve *curve,
+                               const nurbs_TessTolerance *tol,
+                               nurbs_Point **points, int *np);
+
+/**
+ * tessellate a curve adaptively into a caller buffer, see
+ * nurbs_curve_derivatives_into for first and cap
+ * \p curve curve object
+ * \p tol chord height and optional angular tolerance
+ * \p points buffer for cap points, may be NULL
+ * \p first index of the first point to store
+ * \p cap capacity of the buffer in points
+ * \return the number of points, 0 if the tolerance is invalid or out of
+ * memory
+ */
+size_t nurbs_curve_tessellate_tol_into(const nurbs_Curve *curve,
+                                       const nurbs_TessTolerance *tol,
+                                       nurbs_Point *points, size_t first,
+                                       size_t cap);
+
+/**
+ * tessellate the part of a curve inside a clip region.  Knot spans and
+ * pieces of them whose control points lie outside are dropped before they
+ * are refined, so a view showing a small part of a long curve costs little
+ * more than that part.  The result is the polyline of
+ * nurbs_curve_tessellate_tol cut into runs, less the segments that are
+ * certainly outside.  Segments crossing the boundary are kept whole
+ * \p curve curve object
+ * \p tol chord height and optional angular tolerance
+ * \p clip clip region
+ * \p points points of all runs in order, release it with nurbs_free_buffer
+ * \p offsets array of nruns + 1 offsets, the points of run i are points
+ * [offsets[i], offsets[i + 1]), release it with nurbs_free_buffer
+ * \p nruns number of runs, 0 if the curve is outside
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs_curve_tessellate_clip(const nurbs_Curve *curve,
+                                const nurbs_TessTolerance *tol,
+                                const nurbs_ClipRegion *clip,
+                                nurbs_Point **points, size_t **offsets,
+                                size_t *nruns);
+
+/**
+ * create an iterator producing the points of nurbs_curve_tessellate_tol in
+ * chunks.  Only the subdivision state of the current knot span is kept, so
+ * memory does not grow with the length of the curve and the first points are
+ * available before the rest are computed
+ * \p curve curve object, it must outlive the iterator
+ * \p tol chord height and optional angular tolerance
+ * \return iterator object, NULL if the tolerance is invalid or out of
+ * memory, release it with nurbs_tessiter_free
+ */
+nurbs_TessIterator *nurbs_tessiter_new(const nurbs_Curve *curve,
+                                       const nurbs_TessTolerance *tol);
+
+/**
+ * produce the next points of the tessellation
+ * \p it iterator object
+ * \p points buffer for cap points
+ * \p cap capacity of the buffer in points
+ * \p n number of points produced, less than cap only once the last point of
+ * the curve has been produced
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs_tessiter_next(nurbs_TessIterator *it, nurbs_Point *points,
+                        size_t cap, size_t *n);
+
+/**
+ * free a tessellation iterator
+ * \p it iterator object, may be NULL
+ */
+void nurbs_tessiter_free(nurbs_TessIterator *it);
+
+/**
+ * tessellate a curve adaptively, as nurbs_curve_tessellate_tol, into an
+ * object that remembers the points of each knot span.  After control points
+ * are edited, nurbs_tessellation_update redoes only the spans they move, so
+ * the cost of an edit does not depend on the size of the curve
+ * \p curve curve object, it must outlive the tessellation and keep its knots
+ * \p tol chord height and optional angular tolerance
+ * \return tessellation object, NULL if the tolerance is invalid or out of
+ * memory, release it with nurbs_tessellation_free
+ */
+nurbs_Tessellation *nurbs_tessellation_new(const nurbs_Curve *curve,
+                                           const nurbs_TessTolerance *tol);
+
+/**
+ * bring a tessellation up to date after control points of its curve changed,
+ * e.g. by nurbs_curve_set_controlpoints
+ * \p t tessellation object
+ * \p first index of the first changed control point
+ * \p n number of changed control points
+ * \p span0 set to the first re-tessellated span (optional)
+ * \p span1 set to one past the last re-tessellated span (optional)
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs_tessellation_update(nurbs_Tessellation *t, size_t first, size_t n,
+                              size_t *span0, size_t *span1);
+
+/**
+ * \p t tessellation object
+ * \return number of knot spans of the curve domain, empty ones included
+ */
+size_t nurbs_tessellation_nspans(const nurbs_Tessellation *t);
+
+/**
+ * points of one knot span, from its start up to the start of the next span.
+ * The array stays valid until the next update
+ * \p t tessellation object
+ * \p span span index, 0 is the first span of the domain
+ * \p n number of points, 0 for an empty span
+ * \return the points
+ */
+const nurbs_Point *nurbs_tessellation_span(const nurbs_Tessellation *t,
+                                           size_t span, size_t *n);
+
+/**
+ * copy the whole polyline into a caller buffer, the points of all spans
+ * followed by the end point of the curve, see nurbs_curve_derivatives_into
+ * for first and cap
+ * \p t tessellation object
+ * \p points buffer for cap points, may be NULL
+ * \p first index of the first point to store
+ * \p cap capacity of the buffer in points
+ * \return the number of points
+ */
+size_t nurbs_tessellation_points_into(const nurbs_Tessellation *t,
+                                      nurbs_Point *points, size_t first,
+                                      size_t cap);
+
+/**
+ * free a tessellation
+ * \p t tessellation object, may be NULL
+ */
+void nurbs_tessellation_free(nurbs_Tessellation *t);
+
+/**
+ * create a cache of tessellations.  Requests are bucketed by tolerance into
+ * power of two levels, so zooming back and forth reuses earlier results, and
+ * a coarser level is simplified from a cached finer one where possible.  Past
+ * the budget the least recently used tessellations are dropped.  The cache is
+ * not thread safe
+ * \p budget most bytes the cached tessellations may hold
+ * \return cache object, NULL if out of memory, release it with
+ * nurbs_tesscache_free
+ */
+nurbs_TessCache *nurbs_tesscache_new(size_t budget);
+
+/**
+ * tessellate a curve through the cache.  The polyline meets the tolerance,
+ * it is that of the largest power of two up to tol
+ * \p cache cache object
+ * \p curve curve object, the cache key
+ * \p tol chord height tolerance
+ * \p n number of points
+ * \return the points, valid until the next call on the cache, NULL if tol is
+ * not positive or out of memory
+ */
+const nurbs_Point *nurbs_tesscache_get(nurbs_TessCache *cache,
+                                       const nurbs_Curve *curve, double tol,
+                                       size_t *n);
+
+/**
+ * drop the cached tessellations of a curve, needed after it is edited and
+ * before it is freed
+ * \p cache cache object
+ * \p curve curve object, NULL for all curves
+ */
+void nurbs_tesscache_invalidate(nurbs_TessCache *cache,
+                                const nurbs_Curve *curve);
+
+/**
+ * change the byte budget, evicting down to it right away
+ * \p cache cache object
+ * \p budget most bytes the cached tessellations may hold
+ */
+void nurbs_tesscache_set_budget(nurbs_TessCache *cache, size_t budget);
+
+/**
+ * \p cache cache object
+ * \p stats set to the counters and the current size of the cache
+ */
+void nurbs_tesscache_stats(const nurbs_TessCache *cache,
+                           nurbs_TessCacheStats *stats);
+
+/**
+ * free a tessellation cache
+ * \p cache cache object, may be NULL
+ */
+void nurbs_tesscache_free(nurbs_TessCache *cache);
+
+/**
+ * tessellate many curves at once, as nurbs_curve_tessellate_tol does each.
+ * The curves are shared among nthreads threads, which steal from each other
+ * when they run out, so a few expensive curves do not hold up the rest.  The
+ * result is the same whatever the thread count.  The other threads work in
+ * memory from the global allocator, which must therefore be thread safe,
+ * points and offsets come from the allocator of the calling thread
+ * \p curves array of curves
+ * \p n number of curves
+ * \p tol chord height and optional angular tolerance
+ * \p nthreads number of threads, 0 for one per processor
+ * \p points points of all curves in order, release it with nurbs_free_buffer
+ * \p offsets array of n + 1 offsets, the points of curve i are points
+ * [offsets[i], offsets[i + 1]), release it with nurbs_free_buffer
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs_curves_tessellate(const nurbs_Curve *const *curves, size_t n,
+                            const nurbs_TessTolerance *tol, unsigned nthreads,
+                            nurbs_Point **points, size_t **offsets);
+
 #ifdef __cplusplus
 }
 #endif
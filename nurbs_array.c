@@ -21,31 +21,80 @@
  */
 
 #include "nurbs_internal.h"
-#include <stdlib.h>
+#include <math.h>
 #include <string.h>
 
 static inline int nurbs_array_alloc(nurbs_array_t *arr, size_t n);
 
+static void nurbs_array_clear(nurbs_array_t *arr)
+{
+    if (arr->free != NULL && arr->nelts) {
+        uint8_t *p = arr->elts, *pend = arr->elts + (arr->nelts * arr->size);
+        for (; p < pend; p += arr->size)
+            arr->free(p);
+    }
+    arr->nelts = 0;
+}
+
+/* only heap blocks are returned, inline and scratch storage is not ours */
+static inline int nurbs_array_onheap(const nurbs_array_t *arr)
+{
+    return !arr->scratch && arr->elts != arr->inl;
+}
+
 int nurbs_array_init(nurbs_array_t *arr, array_free free, size_t size,
                      size_t nalloc)
 {
     arr->elts = NULL;
+    arr->inl = NULL;
+    arr->ninl = 0;
+    arr->size = size;
+    arr->nalloc = 0;
+    arr->nelts = 0;
+    arr->free = free;
+    arr->growth = NURBS_ARRAY_GROWTH;
+    arr->scratch = 0;
+    return nalloc ? nurbs_array_alloc(arr, nalloc) : 0;
+}
+
+int nurbs_array_init_scratch(nurbs_array_t *arr, array_free free, size_t size,
+                             size_t nalloc)
+{
+    arr->elts = NULL;
+    arr->inl = NULL;
+    arr->ninl = 0;
     arr->size = size;
-    arr->nalloc = nalloc;
+    arr->nalloc = 0;
     arr->nelts = 0;
     arr->free = free;
-    return nurbs_array_alloc(arr, arr->nalloc);
+    arr->growth = NURBS_ARRAY_GROWTH;
+    arr->scratch = 1;
+    return nalloc ? nurbs_array_alloc(arr, nalloc) : 0;
+}
+
+void nurbs_array_init_inline(nurbs_array_t *arr, array_free free, size_t size,
+                             void *buf, size_t nbuf)
+{
+    arr->elts = (uint8_t *)buf;
+    arr->inl = (uint8_t *)buf;
+    arr->ninl = buf ? nbuf : 0;
+    arr->size = size;
+    arr->nalloc = arr->ninl;
+    arr->nelts = 0;
+    arr->free = free;
+    arr->growth = NURBS_ARRAY_GROWTH;
+    arr->scratch = 0;
 }
 
 nurbs_array_t *nurbs_array_new(array_free free, size_t size, size_t nalloc)
 {
     nurbs_array_t *arr;
 
-    if ((arr = (nurbs_array_t *)malloc(sizeof(nurbs_array_t))) == NULL)
+    if ((arr = (nurbs_array_t *)nurbs__memAlloc(sizeof(nurbs_array_t))) == NULL)
         return NULL;
 
     if (nurbs_array_init(arr, free, size, nalloc) < 0) {
-        free(arr);
+        nurbs__memFree(arr);
         return NULL;
     }
     return arr;
@@ -56,13 +105,11 @@ void nurbs_array_destroy(nurbs_array_t *arr)
     if (arr == NULL)
         return;
 
-    if (arr->free != NULL && arr->nelts) {
-        uint8_t p = arr->elts, pend = arr->elts + (arr->nelts * arr->size);
-        for (; p < pend; p += arr->size)
-            arr->free(p);
-    }
-
-    free(arr->elts);
+    nurbs_array_clear(arr);
+    if (nurbs_array_onheap(arr))
+        nurbs__memFree(arr->elts);
+    arr->elts = arr->inl;
+    arr->nalloc = arr->ninl;
 }
 
 void nurbs_array_free(nurbs_array_t *arr)
@@ -70,14 +117,10 @@ void nurbs_array_free(nurbs_array_t *arr)
     if (arr == NULL)
         return;
 
-    if (arr->free != NULL && arr->nelts) {
-        uint8_t p = arr->elts, pend = arr->elts + (arr->nelts * arr->size);
-        for (; p < pend; p += arr->size)
-            arr->free(p);
-    }
-
-    free(arr->elts);
-    free(arr);
+    nurbs_array_clear(arr);
+    if (nurbs_array_onheap(arr))
+        nurbs__memFree(arr->elts);
+    nurbs__memFree(arr);
 }
 
 void nurbs_array_reset(nurbs_array_t *arr)
@@ -85,12 +128,12 @@ void nurbs_array_reset(nurbs_array_t *arr)
     if (arr == NULL)
         return;
 
-    if (arr->free != NULL && arr->nelts) {
-        uint8_t p = arr->elts, pend = arr->elts + (arr->nelts * arr->size);
-        for (; p < pend; p += arr->size)
-            arr->free(p);
-    }
-    arr->nelts = 0;
+    nurbs_array_clear(arr);
+}
+
+void nurbs_array_set_growth(nurbs_array_t *arr, double growth)
+{
+    arr->growth = growth > 1.0 ? growth : NURBS_ARRAY_GROWTH;
 }
 
 void *nurbs_array_push(nurbs_array_t *arr)
@@ -104,7 +147,7 @@ void *nurbs_array_push(nurbs_array_t *arr)
 
 void *nurbs_array_pushn(nurbs_array_t *arr, size_t n)
 {
-    uint8_t ptr;
+    uint8_t *ptr;
 
     if (arr->nelts + n > arr->nalloc) {
         if (nurbs_array_alloc(arr, n) < 0)
@@ -125,22 +168,100 @@ void nurbs_array_pop(nurbs_array_t *arr)
     --arr->nelts;
 }
 
-inline int nurbs_array_alloc(nurbs_array_t *arr, size_t n)
+/* move the elements to a block of exactly num elements */
+static int nurbs_array_move(nurbs_array_t *arr, size_t num)
 {
-    uint8_t ptr;
-    size_t num = arr->nalloc;
-    while (n + arr->nelts > num) {
-        num <<= 1;
+    uint8_t *ptr;
+
+    if (arr->scratch) {
+        /* bump allocated, the old block is reclaimed with the arena */
+        ptr = (uint8_t *)nurbs__memScratchAlloc(num * arr->size);
+        if (ptr != NULL && arr->nelts)
+            memcpy(ptr, arr->elts, arr->nelts * arr->size);
+    }
+    else if (arr->elts == arr->inl) {
+        /* leaving the inline buffer, it stays reserved for a shrink */
+        ptr = (uint8_t *)nurbs__memAlloc(num * arr->size);
+        if (ptr != NULL && arr->nelts)
+            memcpy(ptr, arr->elts, arr->nelts * arr->size);
+    }
+    else {
+        ptr = (uint8_t *)nurbs__memRealloc(arr->elts, num * arr->size);
     }
-    ptr = malloc(num * arr->size);
 
     if (ptr == NULL)
         return -1;
 
-    memcpy(ptr, arr->elts, arr->nelts * arr->size);
-    free(arr->elts);
     arr->elts = ptr;
     arr->nalloc = num;
-
     return 0;
 }
+
+int nurbs_array_reserve(nurbs_array_t *arr, size_t n)
+{
+    if (n <= arr->nalloc)
+        return 0;
+    if (n > SIZE_MAX / arr->size)
+        return -1;
+    return nurbs_array_move(arr, n);
+}
+
+int nurbs_array_shrink(nurbs_array_t *arr)
+{
+    if (!nurbs_array_onheap(arr) || arr->nelts == arr->nalloc)
+        return 0;
+
+    if (arr->inl != NULL && arr->nelts <= arr->ninl) {
+        /* back into the inline buffer */
+        if (arr->nelts)
+            memcpy(arr->inl, arr->elts, arr->nelts * arr->size);
+        nurbs__memFree(arr->elts);
+        arr->elts = arr->inl;
+        arr->nalloc = arr->ninl;
+        return 0;
+    }
+    if (arr->nelts == 0) {
+        nurbs__memFree(arr->elts);
+        arr->elts = NULL;
+        arr->nalloc = 0;
+        return 0;
+    }
+    return nurbs_array_move(arr, arr->nelts);
+}
+
+void *nurbs_array_steal(nurbs_array_t *arr, size_t *n)
+{
+    uint8_t *ptr;
+
+    if (nurbs_array_onheap(arr) && arr->elts != NULL) {
+        ptr = arr->elts;
+        arr->elts = arr->inl;
+        arr->nalloc = arr->ninl;
+    }
+    else {
+        /* inline and scratch storage stays with the array, copy it out */
+        ptr = (uint8_t *)nurbs__memAlloc(
+            (arr->nelts ? arr->nelts : 1) * arr->size);
+        if (ptr == NULL)
+            return NULL;
+        if (arr->nelts)
+            memcpy(ptr, arr->elts, arr->nelts * arr->size);
+    }
+
+    *n = arr->nelts;
+    arr->nelts = 0;
+    return ptr;
+}
+
+static inline int nurbs_array_alloc(nurbs_array_t *arr, size_t n)
+{
+    size_t need = arr->nelts + n;
+    if (need < n || need > SIZE_MAX / arr->size)
+        return -1;
+
+    double grown = ceil((double)arr->nalloc * arr->growth);
+    size_t num = grown < (double)(SIZE_MAX / arr->size) ? (size_t)grown : need;
+    if (num < need)
+        num = need;
+    return nurbs_array_move(arr, num);
+}
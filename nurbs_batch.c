@@ -0,0 +1,349 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* curves a worker takes from its own range at once */
+#define NURBS__BATCHCHUNK 8
+/* points of spare room a worker keeps ahead of its next curve */
+#define NURBS__BATCHROOM 1024
+
+typedef struct {
+    void (*fn)(void *ctx, unsigned worker);
+    void *ctx;
+    unsigned worker;
+} nurbs__BatchThread;
+
+/* a new thread has no thread allocator, it allocates from the global one */
+static void nurbs__batchThreadMain(nurbs__BatchThread *t)
+{
+    t->fn(t->ctx, t->worker);
+    /* the thread ends here, its scratch arena would leak otherwise */
+    nurbs__memScratchTrim();
+}
+
+#if defined(_WIN32)
+static unsigned __stdcall nurbs__batchThreadEntry(void *arg)
+{
+    nurbs__batchThreadMain((nurbs__BatchThread *)arg);
+    return 0;
+}
+#else
+static void *nurbs__batchThreadEntry(void *arg)
+{
+    nurbs__batchThreadMain((nurbs__BatchThread *)arg);
+    return NULL;
+}
+#endif
+
+unsigned nurbs__batchThreads(unsigned nthreads)
+{
+    if (nthreads != 0)
+        return nthreads;
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    nthreads = (unsigned)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = n > 0 ? (unsigned)n : 1;
+#endif
+    return nthreads ? nthreads : 1;
+}
+
+int nurbs__batchRun(unsigned nthreads, void (*fn)(void *ctx, unsigned worker),
+                    void *ctx)
+{
+    nurbs__BatchThread *threads = NULL;
+#if defined(_WIN32)
+    HANDLE *handles = NULL;
+#else
+    pthread_t *handles = NULL;
+#endif
+    unsigned started = 0;
+
+    if (nthreads > 1) {
+        threads = (nurbs__BatchThread *)nurbs__memAlloc(
+            nthreads * sizeof(nurbs__BatchThread));
+        handles = nurbs__memAlloc(nthreads * sizeof(*handles));
+        if (threads == NULL || handles == NULL)
+            goto fail;
+    }
+
+    /* the calling thread is worker 0 */
+    for (unsigned w = 1; w < nthreads; ++w) {
+        nurbs__BatchThread *t = &threads[w];
+        t->fn = fn;
+        t->ctx = ctx;
+        t->worker = w;
+#if defined(_WIN32)
+        handles[w] = (HANDLE)_beginthreadex(NULL, 0, nurbs__batchThreadEntry,
+                                            t, 0, NULL);
+        if (handles[w] == 0)
+            break;
+#else
+        if (pthread_create(&handles[w], NULL, nurbs__batchThreadEntry, t) != 0)
+            break;
+#endif
+        started = w;
+    }
+
+    /* workers whose thread did not start run here after worker 0, so every
+       worker runs exactly once whatever its share of the work */
+    fn(ctx, 0);
+    for (unsigned w = started + 1; w < nthreads; ++w)
+        fn(ctx, w);
+
+    for (unsigned w = 1; w <= started; ++w) {
+#if defined(_WIN32)
+        WaitForSingleObject(handles[w], INFINITE);
+        CloseHandle(handles[w]);
+#else
+        pthread_join(handles[w], NULL);
+#endif
+    }
+    nurbs__memFree(handles);
+    nurbs__memFree(threads);
+    return NURBS_TRUE;
+
+fail:
+    nurbs__memFree(handles);
+    nurbs__memFree(threads);
+    return NURBS_FALSE;
+}
+
+/*
+ * Each worker owns a range [begin, end) of curve indices packed into one
+ * word, so the owner taking chunks from the front and thieves taking the
+ * back half are both a single compare and swap.
+ */
+#define NURBS__RANGE(begin, end) (((uint64_t)(end) << 32) | (uint32_t)(begin))
+#define NURBS__RANGEBEGIN(r)     ((uint32_t)(r))
+#define NURBS__RANGEEND(r)       ((uint32_t)((r) >> 32))
+
+typedef struct {
+    volatile uint64_t range;
+    nurbs_array_t points; /* tessellations of the curves this worker did */
+    unsigned char pad[64]; /* keeps ranges of workers off shared lines */
+} nurbs__BatchWorker;
+
+typedef struct {
+    const nurbs_Curve *const *curves;
+    size_t n;
+    const nurbs_TessTolerance *tol;
+    unsigned nworkers;
+    nurbs__BatchWorker *workers;
+    uint32_t *owner;        /* worker that tessellated each curve */
+    size_t *start;          /* its first point in the worker array */
+    size_t *offsets;        /* n + 1 output offsets */
+    nurbs_Point *out;       /* concatenated output */
+    volatile int failed;
+} nurbs__BatchJob;
+
+/* take the next chunk of the own range, or steal half of another one */
+static int nurbs__batchNext(nurbs__BatchJob *job, unsigned w, uint32_t *begin,
+                            uint32_t *end)
+{
+    volatile uint64_t *own = &job->workers[w].range;
+    uint64_t mine;
+    for (;;) {
+        mine = NURBS__LOAD64(own);
+        uint32_t b = NURBS__RANGEBEGIN(mine), e = NURBS__RANGEEND(mine);
+        if (b >= e)
+            break;
+        uint32_t take = e - b < NURBS__BATCHCHUNK ? e : b + NURBS__BATCHCHUNK;
+        if (NURBS__CAS64(own, mine, NURBS__RANGE(take, e))) {
+            *begin = b;
+            *end = take;
+            return NURBS_TRUE;
+        }
+    }
+
+    for (unsigned i = 1; i < job->nworkers; ++i) {
+        volatile uint64_t *victim =
+            &job->workers[(w + i) % job->nworkers].range;
+        for (;;) {
+            uint64_t r = NURBS__LOAD64(victim);
+            uint32_t b = NURBS__RANGEBEGIN(r), e = NURBS__RANGEEND(r);
+            if (b >= e)
+                break;
+            uint32_t mid = b + (e - b) / 2;
+            if (NURBS__CAS64(victim, r, NURBS__RANGE(b, mid))) {
+                /* the stolen half becomes the own range, its first chunk is
+                   returned right away. The own range is empty, nobody else
+                   changes it */
+                uint32_t take =
+                    e - mid <= NURBS__BATCHCHUNK ? e : mid + NURBS__BATCHCHUNK;
+                NURBS__CAS64(own, mine, NURBS__RANGE(take, e));
+                *begin = mid;
+                *end = take;
+                return NURBS_TRUE;
+            }
+        }
+    }
+    return NURBS_FALSE;
+}
+
+/* append the tessellation of one curve, one pass unless the room runs out */
+static int nurbs__batchTessCurve(const nurbs_CurveData *data,
+                                 const nurbs_TessTolerance *tol,
+                                 nurbs_array_t *points)
+{
+    size_t at = points->nelts;
+    if (points->nalloc - at < NURBS__BATCHROOM &&
+        nurbs_array_reserve(points, 2 * at + NURBS__BATCHROOM) < 0)
+        return NURBS_FALSE;
+
+    nurbs__Out out;
+    size_t room = points->nalloc - at;
+    nurbs__outInit(&out, points->elts + at * sizeof(nurbs_Point),
+                   sizeof(nurbs_Point), 0, room);
+    if (!nurbs__tessCurve(data, tol, &out))
+        return NURBS_FALSE;
+    if (out.count > room) {
+        size_t count = out.count;
+        if (nurbs_array_reserve(points, 2 * at + count) < 0)
+            return NURBS_FALSE;
+        nurbs__outInit(&out, points->elts + at * sizeof(nurbs_Point),
+                       sizeof(nurbs_Point), 0, count);
+        if (!nurbs__tessCurve(data, tol, &out))
+            return NURBS_FALSE;
+    }
+    points->nelts += out.count;
+    return NURBS_TRUE;
+}
+
+static void nurbs__batchTessWorker(void *ctx, unsigned w)
+{
+    nurbs__BatchJob *job = (nurbs__BatchJob *)ctx;
+    nurbs_array_t *points = &job->workers[w].points;
+    uint32_t begin, end;
+
+    while (!job->failed && nurbs__batchNext(job, w, &begin, &end)) {
+        for (uint32_t i = begin; i < end; ++i) {
+            size_t at = points->nelts;
+            if (!nurbs__batchTessCurve(job->curves[i]->nurbs_data, job->tol,
+                                       points)) {
+                job->failed = 1;
+                return;
+            }
+            job->owner[i] = w;
+            job->start[i] = at;
+            job->offsets[i + 1] = points->nelts - at;
+        }
+    }
+}
+
+static void nurbs__batchCopyWorker(void *ctx, unsigned w)
+{
+    nurbs__BatchJob *job = (nurbs__BatchJob *)ctx;
+    size_t n = job->n;
+    size_t first = n * w / job->nworkers, last = n * (w + 1) / job->nworkers;
+
+    for (size_t i = first; i < last; ++i) {
+        const nurbs_array_t *points = &job->workers[job->owner[i]].points;
+        memcpy(job->out + job->offsets[i],
+               points->elts + job->start[i] * sizeof(nurbs_Point),
+               (job->offsets[i + 1] - job->offsets[i]) * sizeof(nurbs_Point));
+    }
+}
+
+int nurbs__batchTessellate(const nurbs_Curve *const *curves, size_t n,
+                           const nurbs_TessTolerance *tol, unsigned nthreads,
+                           nurbs_Point **points, size_t **offsets)
+{
+    nurbs__BatchJob job;
+    nurbs__BatchWorker *workers = NULL;
+    unsigned nworkers = 0;
+    int ok = NURBS_FALSE;
+
+    if (!(tol->chord > 0.0) || !(tol->angle >= 0.0) || n >= UINT32_MAX)
+        return NURBS_FALSE;
+
+    memset(&job, 0, sizeof(job));
+    job.offsets = (size_t *)nurbs__memAlloc((n + 1) * sizeof(size_t));
+    job.owner = (uint32_t *)nurbs__memAlloc((n ? n : 1) * sizeof(uint32_t));
+    job.start = (size_t *)nurbs__memAlloc((n ? n : 1) * sizeof(size_t));
+    if (job.offsets == NULL || job.owner == NULL || job.start == NULL)
+        goto fail;
+
+    /* no more workers than chunks, each worker starts on an even share */
+    nworkers = nurbs__batchThreads(nthreads);
+    if (nworkers > (n + NURBS__BATCHCHUNK - 1) / NURBS__BATCHCHUNK)
+        nworkers = (unsigned)((n + NURBS__BATCHCHUNK - 1) / NURBS__BATCHCHUNK);
+    if (nworkers == 0)
+        nworkers = 1;
+    workers = (nurbs__BatchWorker *)nurbs__memAlloc(nworkers *
+                                                    sizeof(nurbs__BatchWorker));
+    if (workers == NULL)
+        goto fail;
+    for (unsigned w = 0; w < nworkers; ++w) {
+        workers[w].range = NURBS__RANGE(n * w / nworkers,
+                                        n * (w + 1) / nworkers);
+        nurbs_array_init(&workers[w].points, NULL, sizeof(nurbs_Point), 0);
+    }
+
+    job.curves = curves;
+    job.n = n;
+    job.tol = tol;
+    job.nworkers = nworkers;
+    job.workers = workers;
+    if (!nurbs__batchRun(nworkers, nurbs__batchTessWorker, &job) || job.failed)
+        goto fail;
+
+    /* counts to offsets in curve order, whichever worker did the curve */
+    job.offsets[0] = 0;
+    for (size_t i = 0; i < n; ++i)
+        job.offsets[i + 1] += job.offsets[i];
+
+    job.out = (nurbs_Point *)nurbs__memAlloc(
+        (job.offsets[n] ? job.offsets[n] : 1) * sizeof(nurbs_Point));
+    if (job.out == NULL)
+        goto fail;
+    /* the copy splits the curves evenly */
+    if (!nurbs__batchRun(nworkers, nurbs__batchCopyWorker, &job)) {
+        nurbs__memFree(job.out);
+        goto fail;
+    }
+
+    *points = job.out;
+    *offsets = job.offsets;
+    job.offsets = NULL;
+    ok = NURBS_TRUE;
+
+fail:
+    for (unsigned w = 0; workers != NULL && w < nworkers; ++w)
+        nurbs_array_destroy(&workers[w].points);
+    nurbs__memFree(workers);
+    nurbs__memFree(job.start);
+    nurbs__memFree(job.owner);
+    nurbs__memFree(job.offsets);
+    return ok;
+}
@@ -0,0 +1,354 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+#include <math.h>
+
+/* finer levels looked at to derive a missing one, 2^-n of its tolerance */
+#define NURBS__CACHEDERIVE 3
+#define NURBS__CACHEMINBUCKETS 64
+
+/*
+ * A cached tessellation, its points follow the entry in the same block.
+ * Entries are chained in a hash table by (curve, level) and in a list from
+ * most to least recently used.
+ */
+typedef struct nurbs__CacheEntry {
+    const nurbs_Curve *curve;
+    int level;                      /* tolerance is 2^level */
+    size_t npoints;
+    size_t bytes;                   /* size of the whole block */
+    struct nurbs__CacheEntry *next; /* hash chain */
+    struct nurbs__CacheEntry *newer;
+    struct nurbs__CacheEntry *older;
+    nurbs_Point points[];
+} nurbs__CacheEntry;
+
+struct nurbs__TessCache {
+    size_t budget;
+    size_t nbuckets;             /* power of two */
+    nurbs__CacheEntry **buckets; /* hash chains */
+    nurbs__CacheEntry *newest;
+    nurbs__CacheEntry *oldest;
+    nurbs_TessCacheStats stats;
+};
+
+static size_t nurbs__cacheHash(const nurbs_Curve *curve, int level,
+                               size_t nbuckets)
+{
+    uint64_t h = (uint64_t)(uintptr_t)curve * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t)(uint32_t)level * 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 29;
+    return (size_t)h & (nbuckets - 1);
+}
+
+static nurbs__CacheEntry **nurbs__cacheSlot(nurbs_TessCache *cache,
+                                            const nurbs_Curve *curve,
+                                            int level)
+{
+    nurbs__CacheEntry **slot =
+        &cache->buckets[nurbs__cacheHash(curve, level, cache->nbuckets)];
+    while (*slot != NULL &&
+           ((*slot)->curve != curve || (*slot)->level != level))
+        slot = &(*slot)->next;
+    return slot;
+}
+
+static void nurbs__cacheUnlink(nurbs_TessCache *cache, nurbs__CacheEntry *e)
+{
+    if (e->newer != NULL)
+        e->newer->older = e->older;
+    else
+        cache->newest = e->older;
+    if (e->older != NULL)
+        e->older->newer = e->newer;
+    else
+        cache->oldest = e->newer;
+}
+
+static void nurbs__cacheLinkNewest(nurbs_TessCache *cache,
+                                   nurbs__CacheEntry *e)
+{
+    e->newer = NULL;
+    e->older = cache->newest;
+    if (cache->newest != NULL)
+        cache->newest->newer = e;
+    else
+        cache->oldest = e;
+    cache->newest = e;
+}
+
+static void nurbs__cacheDrop(nurbs_TessCache *cache, nurbs__CacheEntry *e)
+{
+    nurbs__CacheEntry **slot = nurbs__cacheSlot(cache, e->curve, e->level);
+    *slot = e->next;
+    nurbs__cacheUnlink(cache, e);
+    cache->stats.bytes -= e->bytes;
+    --cache->stats.entries;
+    nurbs__memFree(e);
+}
+
+/* evict from the old end until the budget holds, sparing keep */
+static void nurbs__cacheTrim(nurbs_TessCache *cache, nurbs__CacheEntry *keep)
+{
+    nurbs__CacheEntry *e = cache->oldest;
+    while (cache->stats.bytes > cache->budget && e != NULL) {
+        nurbs__CacheEntry *newer = e->newer;
+        if (e != keep) {
+            nurbs__cacheDrop(cache, e);
+            ++cache->stats.evictions;
+        }
+        e = newer;
+    }
+}
+
+static int nurbs__cacheGrow(nurbs_TessCache *cache)
+{
+    size_t nbuckets = 2 * cache->nbuckets;
+    nurbs__CacheEntry **buckets = (nurbs__CacheEntry **)nurbs__memCalloc(
+        nbuckets, sizeof(nurbs__CacheEntry *));
+    if (buckets == NULL)
+        return NURBS_FALSE;
+    for (size_t i = 0; i < cache->nbuckets; ++i) {
+        nurbs__CacheEntry *e = cache->buckets[i];
+        while (e != NULL) {
+            nurbs__CacheEntry *next = e->next;
+            size_t h = nurbs__cacheHash(e->curve, e->level, nbuckets);
+            e->next = buckets[h];
+            buckets[h] = e;
+            e = next;
+        }
+    }
+    nurbs__memFree(cache->buckets);
+    cache->buckets = buckets;
+    cache->nbuckets = nbuckets;
+    return NURBS_TRUE;
+}
+
+static nurbs__CacheEntry *nurbs__cacheEntryNew(const nurbs_Curve *curve,
+                                               int level, size_t npoints)
+{
+    size_t bytes = sizeof(nurbs__CacheEntry) + npoints * sizeof(nurbs_Point);
+    nurbs__CacheEntry *e = (nurbs__CacheEntry *)nurbs__memAlloc(bytes);
+    if (e == NULL)
+        return NULL;
+    e->curve = curve;
+    e->level = level;
+    e->npoints = npoints;
+    e->bytes = bytes;
+    return e;
+}
+
+static double nurbs__cacheSegmentDistance(nurbs_Point pt, nurbs_Point a,
+                                          nurbs_Point b)
+{
+    nurbs_Vector ab = nurbs__vecSub(b, a), ap = nurbs__vecSub(pt, a);
+    double ab2 = nurbs__vecDot(ab, ab);
+    double t = ab2 > 0.0 ? nurbs__vecDot(ap, ab) / ab2 : 0.0;
+    t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+    return nurbs__vecNorm(nurbs__vecSub(ap, nurbs__vecMul(ab, t)));
+}
+
+/*
+ * Douglas-Peucker on an explicit stack. The kept points are a subset of a
+ * polyline within tol_fine of the curve, each dropped one lies within eps of
+ * the kept chord, so the result is within tol_fine + eps of the curve.
+ */
+static nurbs__CacheEntry *nurbs__cacheDerive(const nurbs__CacheEntry *fine,
+                                             int level, double eps)
+{
+    const nurbs_Point *P = fine->points;
+    size_t n = fine->npoints;
+    nurbs__CacheEntry *e = NULL;
+
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    unsigned char *keep = (unsigned char *)nurbs__memScratchAlloc(n);
+    size_t *stack = (size_t *)nurbs__memScratchAlloc(2 * n * sizeof(size_t));
+    if (keep == NULL || stack == NULL)
+        goto done;
+
+    memset(keep, 0, n);
+    keep[0] = keep[n - 1] = 1;
+    size_t top = 0, kept = n > 1 ? 2 : 1;
+    if (n > 2) {
+        stack[top++] = 0;
+        stack[top++] = n - 1;
+    }
+    while (top) {
+        size_t j = stack[--top], i = stack[--top];
+        double dmax = 0.0;
+        size_t imax = i;
+        for (size_t m = i + 1; m < j; ++m) {
+            double d = nurbs__cacheSegmentDistance(P[m], P[i], P[j]);
+            if (d > dmax) {
+                dmax = d;
+                imax = m;
+            }
+        }
+        if (dmax <= eps)
+            continue;
+        keep[imax] = 1;
+        ++kept;
+        if (imax - i > 1) {
+            stack[top++] = i;
+            stack[top++] = imax;
+        }
+        if (j - imax > 1) {
+            stack[top++] = imax;
+            stack[top++] = j;
+        }
+    }
+
+    e = nurbs__cacheEntryNew(fine->curve, level, kept);
+    if (e != NULL) {
+        size_t k = 0;
+        for (size_t m = 0; m < n; ++m) {
+            if (keep[m])
+                e->points[k++] = P[m];
+        }
+    }
+
+done:
+    nurbs__memScratchRelease(mark);
+    return e;
+}
+
+static nurbs__CacheEntry *nurbs__cacheTessellate(const nurbs_Curve *curve,
+                                                 int level)
+{
+    nurbs_TessTolerance tol = {ldexp(1.0, level), 0.0};
+    nurbs__Out out;
+    nurbs__outInit(&out, NULL, sizeof(nurbs_Point), 0, 0);
+    if (!nurbs__tessCurve(curve->nurbs_data, &tol, &out))
+        return NULL;
+
+    nurbs__CacheEntry *e = nurbs__cacheEntryNew(curve, level, out.count);
+    if (e == NULL)
+        return NULL;
+    nurbs__outInit(&out, e->points, sizeof(nurbs_Point), 0, e->npoints);
+    if (!nurbs__tessCurve(curve->nurbs_data, &tol, &out)) {
+        nurbs__memFree(e);
+        return NULL;
+    }
+    return e;
+}
+
+nurbs_TessCache *nurbs__cacheNew(size_t budget)
+{
+    nurbs_TessCache *cache =
+        (nurbs_TessCache *)nurbs__memCalloc(1, sizeof(nurbs_TessCache));
+    if (cache == NULL)
+        return NULL;
+    cache->budget = budget;
+    cache->nbuckets = NURBS__CACHEMINBUCKETS;
+    cache->buckets = (nurbs__CacheEntry **)nurbs__memCalloc(
+        cache->nbuckets, sizeof(nurbs__CacheEntry *));
+    if (cache->buckets == NULL) {
+        nurbs__memFree(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+const nurbs_Point *nurbs__cacheGet(nurbs_TessCache *cache,
+                                   const nurbs_Curve *curve, double tol,
+                                   size_t *n)
+{
+    int level;
+    if (!(tol > 0.0) || isinf(tol))
+        return NULL;
+    /* the level tolerance 2^level is the largest power of two up to tol */
+    frexp(tol, &level);
+    --level;
+
+    nurbs__CacheEntry **slot = nurbs__cacheSlot(cache, curve, level);
+    nurbs__CacheEntry *e = *slot;
+    if (e != NULL) {
+        ++cache->stats.hits;
+        nurbs__cacheUnlink(cache, e);
+        nurbs__cacheLinkNewest(cache, e);
+        *n = e->npoints;
+        return e->points;
+    }
+
+    for (int d = 1; d <= NURBS__CACHEDERIVE && e == NULL; ++d) {
+        nurbs__CacheEntry *fine = *nurbs__cacheSlot(cache, curve, level - d);
+        if (fine != NULL) {
+            e = nurbs__cacheDerive(fine, level,
+                                   ldexp(1.0, level) - ldexp(1.0, level - d));
+            if (e == NULL)
+                return NULL;
+            ++cache->stats.derived;
+        }
+    }
+    if (e == NULL) {
+        e = nurbs__cacheTessellate(curve, level);
+        if (e == NULL)
+            return NULL;
+        ++cache->stats.misses;
+    }
+
+    if (cache->stats.entries >= cache->nbuckets)
+        nurbs__cacheGrow(cache);
+    slot = &cache->buckets[nurbs__cacheHash(curve, level, cache->nbuckets)];
+    e->next = *slot;
+    *slot = e;
+    nurbs__cacheLinkNewest(cache, e);
+    cache->stats.bytes += e->bytes;
+    ++cache->stats.entries;
+    nurbs__cacheTrim(cache, e);
+
+    *n = e->npoints;
+    return e->points;
+}
+
+void nurbs__cacheInvalidate(nurbs_TessCache *cache, const nurbs_Curve *curve)
+{
+    nurbs__CacheEntry *e = cache->newest;
+    while (e != NULL) {
+        nurbs__CacheEntry *older = e->older;
+        if (curve == NULL || e->curve == curve)
+            nurbs__cacheDrop(cache, e);
+        e = older;
+    }
+}
+
+void nurbs__cacheSetBudget(nurbs_TessCache *cache, size_t budget)
+{
+    cache->budget = budget;
+    nurbs__cacheTrim(cache, NULL);
+}
+
+void nurbs__cacheStats(const nurbs_TessCache *cache,
+                       nurbs_TessCacheStats *stats)
+{
+    *stats = cache->stats;
+}
+
+void nurbs__cacheFree(nurbs_TessCache *cache)
+{
+    if (cache == NULL)
+        return;
+    nurbs__cacheInvalidate(cache, NULL);
+    nurbs__memFree(cache->buckets);
+    nurbs__memFree(cache);
+}
@@ -20,4 +20,348 @@
  * IN THE SOFTWARE.
  */
 
-#include "nurbs_internal.h"
\ No newline at end of file
+#include "nurbs_internal.h"
+#include <math.h>
+
+#define NURBS__LENGTHDEPTH 20
+#define NURBS__LENGTHITERS 64
+
+/* 8 point Gauss-Legendre rule on [-1, 1], symmetric halves */
+static const double nurbs__divideGaussX[4] = {
+    0.183434642495649804939, 0.525532409916328985818, 0.796666477413626739592,
+    0.960289856497536231684};
+static const double nurbs__divideGaussW[4] = {
+    0.362683783378361982965, 0.313706645877887287338, 0.222381034453374470544,
+    0.101228536290376259153};
+
+static double nurbs__divideGauss(const nurbs__EvalKernel *kernel,
+                                 const nurbs_CurveData *data, double a,
+                                 double b)
+{
+    double m = 0.5 * (a + b), h = 0.5 * (b - a), s = 0.0;
+    for (size_t i = 0; i < 4; ++i) {
+        double dx = h * nurbs__divideGaussX[i];
+        s += nurbs__divideGaussW[i] *
+             (nurbs__vecNorm(kernel->tangent(data, m - dx)) +
+              nurbs__vecNorm(kernel->tangent(data, m + dx)));
+    }
+    return s * h;
+}
+
+/* halves [a, b] until both halves agree with the whole */
+static double nurbs__divideAdaptive(const nurbs__EvalKernel *kernel,
+                                    const nurbs_CurveData *data, double a,
+                                    double b, double whole, int depth)
+{
+    double m = 0.5 * (a + b);
+    double left = nurbs__divideGauss(kernel, data, a, m);
+    double right = nurbs__divideGauss(kernel, data, m, b);
+    double sum = left + right;
+    if (depth == 0 || fabs(sum - whole) <= 1e-13 * sum)
+        return sum;
+    return nurbs__divideAdaptive(kernel, data, a, m, left, depth - 1) +
+           nurbs__divideAdaptive(kernel, data, m, b, right, depth - 1);
+}
+
+/* length of [a, b] within a single knot span */
+static double nurbs__divideSpanLength(const nurbs__EvalKernel *kernel,
+                                      const nurbs_CurveData *data, double a,
+                                      double b)
+{
+    if (b <= a)
+        return 0.0;
+    return nurbs__divideAdaptive(kernel, data, a, b,
+                                 nurbs__divideGauss(kernel, data, a, b),
+                                 NURBS__LENGTHDEPTH);
+}
+
+double nurbs__divideLength(const nurbs_CurveData *data, double a, double b)
+{
+    const nurbs__EvalKernel *kernel = nurbs__evalKernel(data->degree);
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+
+    double len = 0.0;
+    for (size_t k = p; k <= last; ++k) {
+        double lo = fmax(a, U[k]), hi = fmin(b, U[k + 1]);
+        if (lo < hi)
+            len += nurbs__divideSpanLength(kernel, data, lo, hi);
+    }
+    return len;
+}
+
+/* parameter in span [a, b] at length t from a, Newton on the length with a
+ * bisection bracket */
+static double nurbs__divideSpanParam(const nurbs__EvalKernel *kernel,
+                                     const nurbs_CurveData *data, double a,
+                                     double b, double span, double t)
+{
+    if (t <= 0.0)
+        return a;
+    if (t >= span)
+        return b;
+
+    double lo = a, hi = b;
+    double u = a + (b - a) * (t / span);
+    for (int it = 0; it < NURBS__LENGTHITERS; ++it) {
+        double g = nurbs__divideSpanLength(kernel, data, a, u) - t;
+        if (fabs(g) <= 1e-12 * span)
+            break;
+        if (g > 0.0)
+            hi = u;
+        else
+            lo = u;
+        double dg = nurbs__vecNorm(kernel->tangent(data, u));
+        double un = dg > 0.0 ? u - g / dg : lo;
+        if (!(un > lo && un < hi))
+            un = 0.5 * (lo + hi);
+        if (un == u)
+            break;
+        u = un;
+    }
+    return u;
+}
+
+double nurbs__divideParamAtLength(const nurbs_CurveData *data, double len)
+{
+    const nurbs__EvalKernel *kernel = nurbs__evalKernel(data->degree);
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+
+    if (len <= 0.0)
+        return U[p];
+    for (size_t k = p; k <= last; ++k) {
+        if (U[k] >= U[k + 1])
+            continue;
+        double span = nurbs__divideSpanLength(kernel, data, U[k], U[k + 1]);
+        if (len <= span)
+            return nurbs__divideSpanParam(kernel, data, U[k], U[k + 1], span,
+                                          len);
+        len -= span;
+    }
+    return U[last + 1];
+}
+
+/* samples at lengths j * step for j < count, the last one at total */
+static int nurbs__divideSamples(const nurbs_CurveData *data, double step,
+                                size_t count, nurbs__Out *out)
+{
+    const nurbs__EvalKernel *kernel = nurbs__evalKernel(data->degree);
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+    size_t nspans = last - p + 1;
+
+    if (out->first >= count || out->cap == 0) {
+        nurbs__outSkip(out, count);
+        return NURBS_TRUE;
+    }
+
+    /* cumulative span lengths, cum[k - p] is the length up to U[k] */
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    double *cum = (double *)nurbs__memScratchAlloc((nspans + 1) * sizeof(double));
+    if (cum == NULL)
+        return NURBS_FALSE;
+    cum[0] = 0.0;
+    for (size_t k = p; k <= last; ++k) {
+        cum[k - p + 1] =
+            cum[k - p] + nurbs__divideSpanLength(kernel, data, U[k], U[k + 1]);
+    }
+
+    size_t k = p;
+    nurbs__outSkip(out, out->first);
+    for (size_t j = out->first; j < count && nurbs__outWanted(out); ++j) {
+        nurbs_CurveSample sample;
+        if (j + 1 == count && step * (double)j >= cum[nspans] * (1.0 - 1e-12)) {
+            sample.u = U[last + 1];
+            sample.len = cum[nspans];
+        }
+        else {
+            sample.len = step * (double)j;
+            while (k < last && sample.len > cum[k - p + 1])
+                ++k;
+            sample.u = nurbs__divideSpanParam(
+                kernel, data, U[k], U[k + 1], cum[k - p + 1] - cum[k - p],
+                sample.len - cum[k - p]);
+        }
+        nurbs__outPush(out, &sample);
+    }
+    nurbs__outSkip(out, count - out->count);
+
+    nurbs__memScratchRelease(mark);
+    return NURBS_TRUE;
+}
+
+int nurbs__divideEqualArcLength(const nurbs_CurveData *data, size_t divisions,
+                                nurbs__Out *out)
+{
+    if (divisions == 0)
+        return NURBS_FALSE;
+    double total = nurbs__divideLength(data, data->knots[data->degree],
+                                       data->knots[data->nknots -
+                                                   data->degree - 1]);
+    return nurbs__divideSamples(data, total / (double)divisions, divisions + 1,
+                                out);
+}
+
+int nurbs__divideArcLength(const nurbs_CurveData *data, double arclength,
+                           nurbs__Out *out)
+{
+    if (!(arclength > 0.0))
+        return NURBS_FALSE;
+    double total = nurbs__divideLength(data, data->knots[data->degree],
+                                       data->knots[data->nknots -
+                                                   data->degree - 1]);
+    /* a sample that misses the end only by rounding still counts */
+    double n = floor(total / arclength * (1.0 + 1e-12));
+    if (n >= (double)SIZE_MAX)
+        return NURBS_FALSE;
+    return nurbs__divideSamples(data, arclength, (size_t)n + 1, out);
+}
+
+/*
+ * Splitting inserts u until it has multiplicity p, A5.1, then the left curve
+ * keeps control points 0 .. k - s and the right one k - s .. n + r, where k
+ * is the span of u, s its multiplicity and r = p - s the insertions.
+ */
+static int nurbs__divideSplitShape(const nurbs_CurveData *data, double u,
+                                   size_t *k, size_t *s)
+{
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t ncv = data->cv->npoints;
+
+    if (!(u > U[p] && u < U[ncv]))
+        return NURBS_FALSE;
+    *k = nurbs__evalFindSpan(data, u);
+    *s = 0;
+    for (size_t i = *k; i > 0 && U[i] == u && *s < p; --i)
+        ++*s;
+    return NURBS_TRUE;
+}
+
+static void nurbs__divideSplitFill(const nurbs_CurveData *data, double u,
+                                   size_t k, size_t s, nurbs_CurveData *left,
+                                   nurbs_CurveData *right)
+{
+    nurbs__Vec4 R[NURBS__MAXDEGREE + 1];
+    const double *U = data->knots;
+    const nurbs_HPoint *P = data->cv->hpoints;
+    size_t p = data->degree;
+    size_t n = data->cv->npoints - 1;
+    size_t r = p - s;
+    size_t nl = k - s + 1;
+    nurbs_HPoint *QL = left->cv->hpoints, *QR = right->cv->hpoints;
+
+    /* untouched control points */
+    memcpy(QL, P, (k - p + 1) * sizeof(nurbs_HPoint));
+    memcpy(QR + r, P + k - s, (n - k + s + 1) * sizeof(nurbs_HPoint));
+
+    for (size_t i = 0; i <= p - s; ++i)
+        R[i] = P[k - p + i];
+    size_t L = k - p;
+    for (size_t j = 1; j <= r; ++j) {
+        L = k - p + j;
+        for (size_t i = 0; i <= p - j - s; ++i) {
+            double alpha = (u - U[L + i]) / (U[i + k + 1] - U[L + i]);
+            R[i] = nurbs__vec4Add(nurbs__vec4Mul(R[i + 1], alpha),
+                                  nurbs__vec4Mul(R[i], 1.0 - alpha));
+        }
+        QL[L] = R[0];
+        /* Q[k + r - j - s] belongs to the right curve unless it is Q[k - s] */
+        QR[r - j] = R[p - j - s];
+    }
+    for (size_t i = L + 1; i < nl; ++i)
+        QL[i] = R[i - L];
+    /* Q[k - s] closes the left curve and opens the right one */
+    QR[0] = QL[nl - 1];
+
+    for (size_t i = 0; i < nl; ++i)
+        left->knots[i] = U[i];
+    for (size_t i = 0; i <= p; ++i) {
+        left->knots[nl + i] = u;
+        right->knots[i] = u;
+    }
+    for (size_t i = k + 1; i < data->nknots; ++i)
+        right->knots[p + 1 + i - k - 1] = U[i];
+}
+
+size_t nurbs__divideSplitSize(const nurbs_CurveData *data, double u,
+                              size_t size, size_t *nleft, size_t *nright)
+{
+    size_t k, s;
+    if (!nurbs__divideSplitShape(data, u, &k, &s))
+        return 0;
+    size_t p = data->degree;
+    *nleft = k - s + 1;
+    *nright = data->cv->npoints + (p - s) - (k - s);
+
+    /* each curve may carry its span lookup table in the same memory */
+    nurbs_CurveData probe;
+    size_t total = 0;
+    for (int i = 0; i < 2; ++i) {
+        size_t np = i ? *nright : *nleft;
+        probe.degree = data->degree;
+        probe.nknots = (uint32_t)(np + p + 1);
+        total += nurbs__makeSize(size, np, np + p + 1);
+        total += (nurbs__evalKnotIndexSize(&probe) + NURBS__ALIGN - 1) &
+                 ~(size_t)(NURBS__ALIGN - 1);
+    }
+    return total;
+}
+
+int nurbs__divideSplit(const nurbs_CurveData *data, double u, void *mem,
+                       nurbs_Curve *curves[2])
+{
+    size_t k, s, nleft, nright;
+    if (!nurbs__divideSplitSize(data, u, sizeof(nurbs_Curve), &nleft, &nright))
+        return NURBS_FALSE;
+    nurbs__divideSplitShape(data, u, &k, &s);
+
+    unsigned char *m = (unsigned char *)mem;
+    size_t p = data->degree;
+    for (int i = 0; i < 2; ++i) {
+        size_t np = i ? nright : nleft;
+        curves[i] = nurbs__makeLayout(m, sizeof(nurbs_Curve), data->degree, np,
+                                      np + p + 1);
+        m += nurbs__makeSize(sizeof(nurbs_Curve), np, np + p + 1);
+    }
+    nurbs__divideSplitFill(data, u, k, s, curves[0]->nurbs_data,
+                           curves[1]->nurbs_data);
+
+    for (int i = 0; i < 2; ++i) {
+        nurbs_CurveData *d = curves[i]->nurbs_data;
+        size_t isize = nurbs__evalKnotIndexSize(d);
+        if (isize == 0)
+            continue;
+        d->kindex = nurbs__evalFillKnotIndex(d, m);
+        m += (isize + NURBS__ALIGN - 1) & ~(size_t)(NURBS__ALIGN - 1);
+    }
+    return NURBS_TRUE;
+}
+
+int nurbs__divideSplitAlloc(const nurbs_CurveData *data, double u,
+                            nurbs_Curve *curves[2])
+{
+    size_t k, s, nleft, nright;
+    if (!nurbs__divideSplitSize(data, u, sizeof(nurbs_Curve), &nleft, &nright))
+        return NURBS_FALSE;
+    nurbs__divideSplitShape(data, u, &k, &s);
+
+    size_t p = data->degree;
+    curves[0] = nurbs__makeAlloc(sizeof(nurbs_Curve), data->degree, nleft,
+                                 nleft + p + 1);
+    curves[1] = nurbs__makeAlloc(sizeof(nurbs_Curve), data->degree, nright,
+                                 nright + p + 1);
+    if (curves[0] == NULL || curves[1] == NULL) {
+        nurbs__makeFree(curves[0]);
+        nurbs__makeFree(curves[1]);
+        curves[0] = curves[1] = NULL;
+        return NURBS_FALSE;
+    }
+    nurbs__divideSplitFill(data, u, k, s, curves[0]->nurbs_data,
+                           curves[1]->nurbs_data);
+    return NURBS_TRUE;
+}
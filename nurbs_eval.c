@@ -23,26 +23,930 @@
 #include "nurbs_internal.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
-void nurbs__evalHomogenize1d(nurbs_PointArray *pa, double *weights)
+void nurbs__evalHomogenize1d(nurbs_PointArray *pa, const nurbs_Point *points,
+                             const double *weights)
 {
     assert(pa);
-    assert(pa->points);
+    assert(pa->hpoints && points);
 
-    if (weights == NULL) {
-        weights = (double *)malloc(pa->npoints * sizeof(double));
-        if (weights == NULL) {
-            return;
+    nurbs__kernels()->pack(points, weights, pa->npoints, pa->hpoints);
+}
+
+size_t nurbs__evalKnotSpan(uint8_t degree, const double *knots,
+                           uint32_t nknots, double u)
+{
+    size_t n = nknots - degree - 2;
+
+    if (u >= knots[n + 1])
+        return n;
+    if (u <= knots[degree])
+        return degree;
+
+    size_t low = degree, high = n + 1;
+    size_t mid = (low + high) / 2;
+    while (u < knots[mid] || u >= knots[mid + 1]) {
+        if (u < knots[mid])
+            high = mid;
+        else
+            low = mid;
+        mid = (low + high) / 2;
+    }
+    return mid;
+}
+
+size_t nurbs__evalKnotSpanFrom(uint8_t degree, const double *knots,
+                               uint32_t nknots, double u, size_t hint)
+{
+    size_t n = nknots - degree - 2;
+    size_t s = hint < degree ? degree : hint > n ? n : hint;
+
+    for (int step = 0; step < NURBS__SPANWALK; ++step) {
+        if (u < knots[s]) {
+            if (s == degree)
+                return s;
+            --s;
+        }
+        else if (u >= knots[s + 1]) {
+            if (s == n)
+                return s;
+            ++s;
+        }
+        else {
+            return s;
+        }
+    }
+    return nurbs__evalKnotSpan(degree, knots, nknots, u);
+}
+
+size_t nurbs__evalKnotIndexSize(const nurbs_CurveData *data)
+{
+    if (data->nknots - 2 * (size_t)data->degree - 1 < NURBS__KINDEXMIN)
+        return 0;
+    size_t nbuckets = 2 * (data->nknots - 2 * (size_t)data->degree - 1);
+    return sizeof(struct nurbs__KnotIndex) + nbuckets * sizeof(uint32_t);
+}
+
+struct nurbs__KnotIndex *nurbs__evalBuildKnotIndex(const nurbs_CurveData *data)
+{
+    struct nurbs__KnotIndex *index = (struct nurbs__KnotIndex *)nurbs__memAlloc(
+        nurbs__evalKnotIndexSize(data));
+    if (index == NULL)
+        return NULL;
+    return nurbs__evalFillKnotIndex(data, index);
+}
+
+struct nurbs__KnotIndex *nurbs__evalFillKnotIndex(const nurbs_CurveData *data,
+                                                  void *mem)
+{
+    struct nurbs__KnotIndex *index = (struct nurbs__KnotIndex *)mem;
+    const double *knots = data->knots;
+    size_t p = data->degree;
+    size_t n = data->nknots - p - 2;
+    double umin = knots[p], umax = knots[n + 1];
+    size_t nbuckets = 2 * (n - p + 1);
+
+    double width = (umax - umin) / (double)nbuckets;
+    index->umin = umin;
+    index->scale = width > 0.0 ? 1.0 / width : 0.0;
+    index->nbuckets = nbuckets;
+
+    size_t s = p;
+    for (size_t b = 0; b < nbuckets; ++b) {
+        double u = umin + (double)b * width;
+        while (s < n && u >= knots[s + 1])
+            ++s;
+        index->span[b] = (uint32_t)s;
+    }
+    return index;
+}
+
+size_t nurbs__evalFindSpan(const nurbs_CurveData *data, double u)
+{
+    struct nurbs__KnotIndex *index = data->kindex;
+    size_t p = data->degree;
+
+    if (data->nknots - 2 * p - 1 < NURBS__KINDEXMIN)
+        return nurbs__evalKnotSpan(data->degree, data->knots, data->nknots, u);
+
+    if (index == NULL) {
+        /* lazily built, the curve data only caches it */
+        index = nurbs__evalBuildKnotIndex(data);
+        if (index == NULL)
+            return nurbs__evalKnotSpan(data->degree, data->knots,
+                                       data->nknots, u);
+        nurbs_CurveData *mdata = (nurbs_CurveData *)data;
+        if (!NURBS__CASPTR(&mdata->kindex, NULL, index)) {
+            nurbs__memFree(index);
+            index = data->kindex;
+        }
+    }
+
+    double b = (u - index->umin) * index->scale;
+    size_t i = 0;
+    if (b >= (double)index->nbuckets)
+        i = index->nbuckets - 1;
+    else if (b > 0.0)
+        i = (size_t)b;
+    return nurbs__evalKnotSpanFrom(data->degree, data->knots, data->nknots, u,
+                                   index->span[i]);
+}
+
+void nurbs__evalBasisFunctions(size_t span, double u, uint8_t degree,
+                               const double *knots, double *N)
+{
+    double left[NURBS__MAXDEGREE + 1];
+    double right[NURBS__MAXDEGREE + 1];
+
+    assert(degree <= NURBS__MAXDEGREE);
+
+    N[0] = 1.0;
+    for (size_t j = 1; j <= degree; ++j) {
+        left[j] = u - knots[span + 1 - j];
+        right[j] = knots[span + j] - u;
+        double saved = 0.0;
+        for (size_t r = 0; r < j; ++r) {
+            double temp = N[r] / (right[r + 1] + left[j - r]);
+            N[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        N[j] = saved;
+    }
+}
+
+void nurbs__evalBasisFunctionsD1(size_t span, double u, uint8_t degree,
+                                 const double *knots, double *N, double *dN)
+{
+    double left[NURBS__MAXDEGREE + 1];
+    double right[NURBS__MAXDEGREE + 1];
+
+    assert(degree <= NURBS__MAXDEGREE);
+
+    N[0] = 1.0;
+    dN[0] = 0.0;
+    for (size_t j = 1; j <= degree; ++j) {
+        left[j] = u - knots[span + 1 - j];
+        right[j] = knots[span + j] - u;
+        double saved = 0.0, prev = 0.0;
+        for (size_t r = 0; r < j; ++r) {
+            double temp = N[r] / (right[r + 1] + left[j - r]);
+            N[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+            /* on the last level N'(r) = p * (temp(r - 1) - temp(r)) */
+            dN[r] = degree * (prev - temp);
+            prev = temp;
+        }
+        N[j] = saved;
+        dN[j] = degree * prev;
+    }
+}
+
+void nurbs__evalDersBasisFunctions(size_t span, double u, uint8_t degree,
+                                   size_t n, const double *knots, double *ders)
+{
+    double ndu[NURBS__MAXDEGREE + 1][NURBS__MAXDEGREE + 1];
+    double a[2][NURBS__MAXDEGREE + 1];
+    double left[NURBS__MAXDEGREE + 1];
+    double right[NURBS__MAXDEGREE + 1];
+    size_t p = degree;
+
+    assert(degree <= NURBS__MAXDEGREE && n <= p);
+
+    ndu[0][0] = 1.0;
+    for (size_t j = 1; j <= p; ++j) {
+        left[j] = u - knots[span + 1 - j];
+        right[j] = knots[span + j] - u;
+        double saved = 0.0;
+        for (size_t r = 0; r < j; ++r) {
+            ndu[j][r] = right[r + 1] + left[j - r];
+            double temp = ndu[r][j - 1] / ndu[j][r];
+            ndu[r][j] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        ndu[j][j] = saved;
+    }
+
+    for (size_t j = 0; j <= p; ++j)
+        ders[j] = ndu[j][p];
+
+    for (size_t r = 0; r <= p; ++r) {
+        size_t s1 = 0, s2 = 1;
+        a[0][0] = 1.0;
+        for (size_t k = 1; k <= n; ++k) {
+            double d = 0.0;
+            ptrdiff_t rk = (ptrdiff_t)r - (ptrdiff_t)k;
+            size_t pk = p - k;
+            size_t j1, j2;
+            if (r >= k) {
+                a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+                d = a[s2][0] * ndu[rk][pk];
+            }
+            j1 = rk >= -1 ? 1 : (size_t)(-rk);
+            j2 = r <= pk + 1 ? k - 1 : p - r;
+            for (size_t j = j1; j <= j2; ++j) {
+                size_t rj = (size_t)(rk + (ptrdiff_t)j);
+                a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rj];
+                d += a[s2][j] * ndu[rj][pk];
+            }
+            if (r <= pk) {
+                a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+                d += a[s2][k] * ndu[r][pk];
+            }
+            ders[k * (p + 1) + r] = d;
+            size_t t = s1;
+            s1 = s2;
+            s2 = t;
+        }
+    }
+
+    double f = (double)p;
+    for (size_t k = 1; k <= n; ++k) {
+        for (size_t j = 0; j <= p; ++j)
+            ders[k * (p + 1) + j] *= f;
+        f *= (double)(p - k);
+    }
+}
+
+void nurbs__evalCurveDerivatives(const nurbs_CurveData *data, double u,
+                                 size_t n, nurbs_Vector *ck)
+{
+    double ders[(NURBS__MAXDEGREE + 1) * (NURBS__MAXDEGREE + 1)];
+    double aders[NURBS__MAXDEGREE + 1][3];
+    double wders[NURBS__MAXDEGREE + 1];
+    const nurbs_HPoint *pts = data->cv->hpoints;
+    size_t p = data->degree;
+    size_t du = n < p ? n : p;
+
+    size_t span = nurbs__evalFindSpan(data, u);
+    nurbs__evalDersBasisFunctions(span, u, data->degree, du, data->knots,
+                                  ders);
+
+    for (size_t k = 0; k <= du; ++k) {
+        aders[k][0] = aders[k][1] = aders[k][2] = wders[k] = 0.0;
+        for (size_t j = 0; j <= p; ++j) {
+            double nkj = ders[k * (p + 1) + j];
+            const nurbs_HPoint *pt = &pts[span - p + j];
+            aders[k][0] += nkj * pt->x;
+            aders[k][1] += nkj * pt->y;
+            aders[k][2] += nkj * pt->z;
+            wders[k] += nkj * pt->w;
+        }
+    }
+
+    /* rational derivatives, A4.2; derivatives above the degree vanish */
+    for (size_t k = 0; k <= n; ++k) {
+        double v[3] = {0.0, 0.0, 0.0};
+        if (k <= du) {
+            v[0] = aders[k][0];
+            v[1] = aders[k][1];
+            v[2] = aders[k][2];
+        }
+        double bin = 1.0;
+        for (size_t i = 1; i <= k && i <= du; ++i) {
+            bin = bin * (double)(k - i + 1) / (double)i;
+            v[0] -= bin * wders[i] * ck[k - i].x;
+            v[1] -= bin * wders[i] * ck[k - i].y;
+            v[2] -= bin * wders[i] * ck[k - i].z;
+        }
+        ck[k].x = v[0] / wders[0];
+        ck[k].y = v[1] / wders[0];
+        ck[k].z = v[2] / wders[0];
+    }
+}
+
+/* ----------------------------- Degree kernels ----------------------------- */
+
+/*
+ * Unrolled versions of nurbs__evalBasisFunctionsD1 for p = 1, 2, 3. The
+ * temporaries of the last Cox-de Boor level give the first derivatives, so
+ * values and derivatives come out of the same pass. Callers that only need
+ * values let the compiler drop the dN stores after inlining.
+ */
+static inline void nurbs__evalBasisP1(size_t i, double u, const double *U,
+                                      double *N, double *dN)
+{
+    double l1 = u - U[i], r1 = U[i + 1] - u;
+    double t = 1.0 / (r1 + l1);
+    N[0] = r1 * t;
+    N[1] = l1 * t;
+    dN[0] = -t;
+    dN[1] = t;
+}
+
+static inline void nurbs__evalBasisP2(size_t i, double u, const double *U,
+                                      double *N, double *dN)
+{
+    double l1 = u - U[i], r1 = U[i + 1] - u;
+    double l2 = u - U[i - 1], r2 = U[i + 2] - u;
+    double t = 1.0 / (r1 + l1);
+    double a0 = r1 * t, a1 = l1 * t;
+    double t0 = a0 / (r1 + l2);
+    double t1 = a1 / (r2 + l1);
+    N[0] = r1 * t0;
+    N[1] = l2 * t0 + r2 * t1;
+    N[2] = l1 * t1;
+    dN[0] = -2.0 * t0;
+    dN[1] = 2.0 * (t0 - t1);
+    dN[2] = 2.0 * t1;
+}
+
+static inline void nurbs__evalBasisP3(size_t i, double u, const double *U,
+                                      double *N, double *dN)
+{
+    double l1 = u - U[i], r1 = U[i + 1] - u;
+    double l2 = u - U[i - 1], r2 = U[i + 2] - u;
+    double l3 = u - U[i - 2], r3 = U[i + 3] - u;
+    double t = 1.0 / (r1 + l1);
+    double a0 = r1 * t, a1 = l1 * t;
+    double t0 = a0 / (r1 + l2);
+    double t1 = a1 / (r2 + l1);
+    double b0 = r1 * t0, b1 = l2 * t0 + r2 * t1, b2 = l1 * t1;
+    double T0 = b0 / (r1 + l3);
+    double T1 = b1 / (r2 + l2);
+    double T2 = b2 / (r3 + l1);
+    N[0] = r1 * T0;
+    N[1] = l3 * T0 + r2 * T1;
+    N[2] = l2 * T1 + r3 * T2;
+    N[3] = l1 * T2;
+    dN[0] = -3.0 * T0;
+    dN[1] = 3.0 * (T0 - T1);
+    dN[2] = 3.0 * (T1 - T2);
+    dN[3] = 3.0 * T2;
+}
+
+static inline void nurbs__evalBasisPN(size_t i, double u, uint8_t p,
+                                      const double *U, double *N, double *dN)
+{
+    switch (p) {
+    case 1:
+        nurbs__evalBasisP1(i, u, U, N, dN);
+        break;
+    case 2:
+        nurbs__evalBasisP2(i, u, U, N, dN);
+        break;
+    case 3:
+        nurbs__evalBasisP3(i, u, U, N, dN);
+        break;
+    default:
+        nurbs__evalBasisFunctionsD1(i, u, p, U, N, dN);
+        break;
+    }
+}
+
+static inline nurbs__Vec4 nurbs__evalControlPoint(const nurbs_PointArray *cv,
+                                                  size_t k)
+{
+    return cv->hpoints[k];
+}
+
+/* sum the control points of a span against the basis, then project */
+static inline void nurbs__evalSum(const nurbs_PointArray *cv, size_t span,
+                                  size_t p, const double *N, const double *dN,
+                                  nurbs_Point *pt, nurbs_Vector *d1)
+{
+    nurbs__Vec4 h = nurbs__vec4(0.0, 0.0, 0.0, 0.0), dh = h;
+
+    for (size_t j = 0, k = span - p; j <= p; ++j, ++k) {
+        nurbs__Vec4 c = nurbs__evalControlPoint(cv, k);
+        h = nurbs__vec4Madd(h, c, N[j]);
+        if (d1)
+            dh = nurbs__vec4Madd(dh, c, dN[j]);
+    }
+
+    *pt = nurbs__vec4Dehomogenize(h);
+    if (d1)
+        *d1 = nurbs__vec4DehomogenizeD1(h, dh);
+}
+
+/*
+ * Point and first derivative with a compile-time degree: every caller below
+ * passes a constant p, so the switch and the accumulation loops fold away.
+ */
+static inline void nurbs__evalCurvePointP(const nurbs_CurveData *data,
+                                          double u, uint8_t p,
+                                          nurbs_Point *pt, nurbs_Vector *d1)
+{
+    double N[NURBS__MAXDEGREE + 1], dN[NURBS__MAXDEGREE + 1];
+
+    size_t span = nurbs__evalFindSpan(data, u);
+    nurbs__evalBasisPN(span, u, p, data->knots, N, dN);
+    nurbs__evalSum(data->cv, span, p, N, dN, pt, d1);
+}
+
+#define NURBS__EVAL_KERNEL(P)                                               \
+    static nurbs_Point nurbs__evalCurvePoint##P(const nurbs_CurveData *data, \
+                                                double u)                   \
+    {                                                                       \
+        nurbs_Point pt;                                                     \
+        nurbs__evalCurvePointP(data, u, P, &pt, NULL);                      \
+        return pt;                                                          \
+    }                                                                       \
+    static nurbs_Vector nurbs__evalCurveTangent##P(                         \
+        const nurbs_CurveData *data, double u)                              \
+    {                                                                       \
+        nurbs_Point pt;                                                     \
+        nurbs_Vector d1;                                                    \
+        nurbs__evalCurvePointP(data, u, P, &pt, &d1);                       \
+        return d1;                                                          \
+    }
+
+NURBS__EVAL_KERNEL(1)
+NURBS__EVAL_KERNEL(2)
+NURBS__EVAL_KERNEL(3)
+
+static nurbs_Vector nurbs__evalCurveTangentN(const nurbs_CurveData *data,
+                                             double u)
+{
+    nurbs_Point pt;
+    nurbs_Vector d1;
+    nurbs__evalCurvePointP(data, u, data->degree, &pt, &d1);
+    return d1;
+}
+
+nurbs_Point nurbs__evalCurvePoint(const nurbs_CurveData *data, double u)
+{
+    double N[NURBS__MAXDEGREE + 1];
+    nurbs_Point pt;
+    uint8_t p = data->degree;
+
+    size_t span = nurbs__evalFindSpan(data, u);
+    nurbs__evalBasisFunctions(span, u, p, data->knots, N);
+    nurbs__evalSum(data->cv, span, p, N, NULL, &pt, NULL);
+    return pt;
+}
+
+/*
+ * Evaluate one block of at most NURBS__LANES parameters whose spans are
+ * already known. The basis functions are computed lane by lane in the inner
+ * loops so the compiler can keep them in vector registers; only the knot and
+ * control point loads are gathers.
+ */
+static inline void nurbs__evalCurvePointsBlock(const nurbs_CurveData *data,
+                                               size_t p, const double *u,
+                                               const size_t *span, size_t nl,
+                                               double *x, double *y, double *z)
+{
+    double N[NURBS__MAXDEGREE + 1][NURBS__LANES];
+    double left[NURBS__MAXDEGREE + 1][NURBS__LANES];
+    double right[NURBS__MAXDEGREE + 1][NURBS__LANES];
+    double saved[NURBS__LANES];
+    double hx[NURBS__LANES], hy[NURBS__LANES], hz[NURBS__LANES];
+    double hw[NURBS__LANES];
+    const double *knots = data->knots;
+    const nurbs_HPoint *pts = data->cv->hpoints;
+
+    for (size_t l = 0; l < NURBS__LANES; ++l)
+        N[0][l] = 1.0;
+
+    for (size_t j = 1; j <= p; ++j) {
+        for (size_t l = 0; l < nl; ++l) {
+            left[j][l] = u[l] - knots[span[l] + 1 - j];
+            right[j][l] = knots[span[l] + j] - u[l];
+        }
+        for (size_t l = nl; l < NURBS__LANES; ++l) {
+            left[j][l] = 1.0;
+            right[j][l] = 1.0;
         }
-        for (size_t i = 0; i < pa->npoints; i++) {
-            weights[i] = 1.0;
+        for (size_t l = 0; l < NURBS__LANES; ++l)
+            saved[l] = 0.0;
+        for (size_t r = 0; r < j; ++r) {
+            for (size_t l = 0; l < NURBS__LANES; ++l) {
+                double temp = N[r][l] / (right[r + 1][l] + left[j - r][l]);
+                N[r][l] = saved[l] + right[r + 1][l] * temp;
+                saved[l] = left[j - r][l] * temp;
+            }
         }
+        for (size_t l = 0; l < NURBS__LANES; ++l)
+            N[j][l] = saved[l];
     }
 
-    for (size_t i = 0; i < pa->npoints; i++) {
-        pa->points[i].x = pa->points[i].x * weights[i];
-        pa->points[i].y = pa->points[i].y * weights[i];
-        pa->points[i].z = pa->points[i].z * weights[i];
+    for (size_t l = 0; l < nl; ++l)
+        hx[l] = hy[l] = hz[l] = hw[l] = 0.0;
+
+    for (size_t j = 0; j <= p; ++j) {
+        for (size_t l = 0; l < nl; ++l) {
+            size_t k = span[l] - p + j;
+            hx[l] += N[j][l] * pts[k].x;
+            hy[l] += N[j][l] * pts[k].y;
+            hz[l] += N[j][l] * pts[k].z;
+            hw[l] += N[j][l] * pts[k].w;
+        }
+    }
+
+    for (size_t l = 0; l < nl; ++l) {
+        x[l] = hx[l] / hw[l];
+        y[l] = hy[l] / hw[l];
+        z[l] = hz[l] / hw[l];
+    }
+}
+
+typedef void (*nurbs__EvalBlockFn)(const nurbs_CurveData *data,
+                                   const double *u, const size_t *span,
+                                   size_t nl, double *x, double *y, double *z);
+
+#define NURBS__EVAL_BLOCK(P, DEG)                                           \
+    static void nurbs__evalCurvePointsBlock##P(                             \
+        const nurbs_CurveData *data, const double *u, const size_t *span,   \
+        size_t nl, double *x, double *y, double *z)                         \
+    {                                                                       \
+        nurbs__evalCurvePointsBlock(data, DEG, u, span, nl, x, y, z);       \
+    }
+
+NURBS__EVAL_BLOCK(1, 1)
+NURBS__EVAL_BLOCK(2, 2)
+NURBS__EVAL_BLOCK(3, 3)
+NURBS__EVAL_BLOCK(N, data->degree)
+
+static const struct {
+    nurbs__EvalKernel kernel;
+    nurbs__EvalBlockFn block;
+} nurbs__evalKernels[] = {
+    {{nurbs__evalCurvePoint, nurbs__evalCurveTangentN},
+     nurbs__evalCurvePointsBlockN},
+    {{nurbs__evalCurvePoint1, nurbs__evalCurveTangent1},
+     nurbs__evalCurvePointsBlock1},
+    {{nurbs__evalCurvePoint2, nurbs__evalCurveTangent2},
+     nurbs__evalCurvePointsBlock2},
+    {{nurbs__evalCurvePoint3, nurbs__evalCurveTangent3},
+     nurbs__evalCurvePointsBlock3},
+};
+
+static inline size_t nurbs__evalKernelIndex(uint8_t degree)
+{
+    return degree >= 1 && degree <= 3 ? degree : 0;
+}
+
+const nurbs__EvalKernel *nurbs__evalKernel(uint8_t degree)
+{
+    return &nurbs__evalKernels[nurbs__evalKernelIndex(degree)].kernel;
+}
+
+static int nurbs__evalIsSorted(const double *us, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        if (us[i] < us[i - 1])
+            return NURBS_FALSE;
+    }
+    return NURBS_TRUE;
+}
+
+/* sorted input: walk the spans forward instead of searching for each one */
+static void nurbs__evalCurvePointsSorted(const nurbs_CurveData *data,
+                                         nurbs__EvalBlockFn block,
+                                         const double *us, size_t n, double *x,
+                                         double *y, double *z)
+{
+    size_t span[NURBS__LANES];
+    size_t s = nurbs__evalFindSpan(data, us[0]);
+
+    for (size_t i = 0; i < n; i += NURBS__LANES) {
+        size_t nl = n - i < NURBS__LANES ? n - i : NURBS__LANES;
+        for (size_t l = 0; l < nl; ++l) {
+            s = nurbs__evalKnotSpanFrom(data->degree, data->knots,
+                                        data->nknots, us[i + l], s);
+            span[l] = s;
+        }
+        block(data, us + i, span, nl, x + i, y + i, z + i);
+    }
+}
+
+/*
+ * unsorted input: find every span once, then bucket the parameters by span
+ * (counting sort) so that each block shares its control points and knots
+ */
+static int nurbs__evalCurvePointsUnsorted(const nurbs_CurveData *data,
+                                          nurbs__EvalBlockFn block,
+                                          const double *us, size_t n,
+                                          double *x, double *y, double *z)
+{
+    size_t nspans = data->nknots - 2 * data->degree - 1;
+    size_t p = data->degree;
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    uint32_t *spans = (uint32_t *)nurbs__memScratchAlloc(n * sizeof(uint32_t));
+    size_t *order = (size_t *)nurbs__memScratchAlloc(n * sizeof(size_t));
+    size_t *count =
+        (size_t *)nurbs__memScratchAlloc((nspans + 1) * sizeof(size_t));
+    if (spans == NULL || order == NULL || count == NULL) {
+        nurbs__memScratchRelease(mark);
+        return NURBS_FALSE;
+    }
+    memset(count, 0, (nspans + 1) * sizeof(size_t));
+
+    for (size_t i = 0; i < n; ++i) {
+        spans[i] = (uint32_t)nurbs__evalFindSpan(data, us[i]);
+        count[spans[i] - p + 1]++;
+    }
+    for (size_t s = 1; s <= nspans; ++s)
+        count[s] += count[s - 1];
+    for (size_t i = 0; i < n; ++i)
+        order[count[spans[i] - p]++] = i;
+
+    for (size_t i = 0; i < n; i += NURBS__LANES) {
+        double u[NURBS__LANES], bx[NURBS__LANES], by[NURBS__LANES];
+        double bz[NURBS__LANES];
+        size_t span[NURBS__LANES];
+        size_t nl = n - i < NURBS__LANES ? n - i : NURBS__LANES;
+
+        for (size_t l = 0; l < nl; ++l) {
+            u[l] = us[order[i + l]];
+            span[l] = spans[order[i + l]];
+        }
+        block(data, u, span, nl, bx, by, bz);
+        for (size_t l = 0; l < nl; ++l) {
+            x[order[i + l]] = bx[l];
+            y[order[i + l]] = by[l];
+            z[order[i + l]] = bz[l];
+        }
+    }
+
+    nurbs__memScratchRelease(mark);
+    return NURBS_TRUE;
+}
+
+int nurbs__evalCurvePoints(const nurbs_CurveData *data, const double *us,
+                           size_t n, double *x, double *y, double *z)
+{
+    assert(data);
+    assert(data->degree <= NURBS__MAXDEGREE);
+
+    if (n == 0)
+        return NURBS_TRUE;
+
+    nurbs__EvalBlockFn block =
+        nurbs__evalKernels[nurbs__evalKernelIndex(data->degree)].block;
+    if (nurbs__evalIsSorted(us, n)) {
+        nurbs__evalCurvePointsSorted(data, block, us, n, x, y, z);
+        return NURBS_TRUE;
+    }
+    return nurbs__evalCurvePointsUnsorted(data, block, us, n, x, y, z);
+}
+
+/* --------------------------------- Cursor --------------------------------- */
+
+void nurbs__evalCursorPoint(nurbs_CurveCursor *cursor, double u,
+                            nurbs_Point *pt, nurbs_Vector *d1)
+{
+    const nurbs_CurveData *data = cursor->data;
+
+    /* a repeated parameter, e.g. point then tangent, reuses the basis */
+    if (u != cursor->u) {
+        cursor->span = nurbs__evalKnotSpanFrom(data->degree, data->knots,
+                                               data->nknots, u, cursor->span);
+        nurbs__evalBasisPN(cursor->span, u, data->degree, data->knots,
+                           cursor->N, cursor->dN);
+        cursor->u = u;
+    }
+
+    nurbs__evalSum(data->cv, cursor->span, data->degree, cursor->N,
+                   cursor->dN, pt, d1);
+}
+
+/* ----------------------------- Compiled curve ----------------------------- */
+
+nurbs_CompiledCurve *nurbs__evalCompileCurve(const nurbs_CurveData *data)
+{
+    double bezier[(NURBS__MAXDEGREE + 1) * 4];
+    double binom[NURBS__MAXDEGREE + 1][NURBS__MAXDEGREE + 1];
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+    size_t nspans = 0;
+
+    assert(p <= NURBS__MAXDEGREE);
+
+    for (size_t k = p; k <= last; ++k) {
+        if (U[k] < U[k + 1])
+            ++nspans;
+    }
+
+    /* all knots coincide, there is no span to compile */
+    if (nspans == 0)
+        return NULL;
+
+    size_t ncoeffs = nspans * (p + 1) * 4;
+    nurbs_CompiledCurve *cc = (nurbs_CompiledCurve *)nurbs__memAlloc(
+        sizeof(nurbs_CompiledCurve) + (nspans + 1 + ncoeffs) * sizeof(double));
+    if (cc == NULL)
+        return NULL;
+
+    cc->degree = data->degree;
+    cc->nspans = (uint32_t)nspans;
+    cc->breaks = (double *)(cc + 1);
+    cc->coeffs = cc->breaks + nspans + 1;
+
+    for (size_t i = 0; i <= p; ++i) {
+        binom[i][0] = binom[i][i] = 1.0;
+        for (size_t j = 1; j < i; ++j)
+            binom[i][j] = binom[i - 1][j - 1] + binom[i - 1][j];
+    }
+
+    double *c = cc->coeffs;
+    size_t s = 0;
+    for (size_t k = p; k <= last; ++k) {
+        if (U[k] >= U[k + 1])
+            continue;
+        cc->breaks[s++] = U[k];
+        nurbs__modifySpanBezier(data, k, bezier);
+        /* c_j = C(p, j) * sum_i (-1)^(j - i) C(j, i) b_i */
+        for (size_t j = 0; j <= p; ++j) {
+            for (size_t d = 0; d < 4; ++d) {
+                double sum = 0.0;
+                for (size_t i = 0; i <= j; ++i) {
+                    double t = binom[j][i] * bezier[4 * i + d];
+                    sum += (j - i) % 2 ? -t : t;
+                }
+                c[4 * j + d] = binom[p][j] * sum;
+            }
+        }
+        c += (p + 1) * 4;
+    }
+    cc->breaks[nspans] = U[last + 1];
+    return cc;
+}
+
+void nurbs__evalCompiledPoint(const nurbs_CompiledCurve *cc, double u,
+                              nurbs_Point *pt, nurbs_Vector *d1)
+{
+    const double *breaks = cc->breaks;
+    size_t p = cc->degree;
+    size_t lo = 0, hi = cc->nspans;
+
+    /* largest span whose start is <= u, clamped to the domain */
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (u < breaks[mid])
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    double len = breaks[lo + 1] - breaks[lo];
+    double t = (u - breaks[lo]) / len;
+    const double *c = cc->coeffs + lo * (p + 1) * 4;
+    double h[4], dh[4] = {0.0, 0.0, 0.0, 0.0};
+
+    for (size_t d = 0; d < 4; ++d)
+        h[d] = c[4 * p + d];
+    for (size_t j = p; j-- > 0;) {
+        for (size_t d = 0; d < 4; ++d) {
+            dh[d] = dh[d] * t + h[d];
+            h[d] = h[d] * t + c[4 * j + d];
+        }
+    }
+
+    nurbs__Vec4 hv = nurbs__vec4(h[0], h[1], h[2], h[3]);
+    *pt = nurbs__vec4Dehomogenize(hv);
+    if (d1) {
+        /* chain rule, dt/du = 1 / len */
+        nurbs__Vec4 dhv = nurbs__vec4(dh[0], dh[1], dh[2], dh[3]);
+        *d1 = nurbs__vecDiv(nurbs__vec4DehomogenizeD1(hv, dhv), len);
+    }
+}
+
+nurbs_CompiledCurveF *nurbs__evalCompileCurveF(const nurbs_CurveData *data)
+{
+    double bezier[(NURBS__MAXDEGREE + 1) * 4];
+    const nurbs_PointArray *cv = data->cv;
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+    const double eps = 1.0 / 16777216.0; /* 2^-24, float unit roundoff */
+    double k = 3.0 * p + 4.0;
+
+    /* also refuses a curve without a nonzero span, so nspans >= 1 below */
+    nurbs_CompiledCurve *dcc = nurbs__evalCompileCurve(data);
+    if (dcc == NULL)
+        return NULL;
+
+    size_t nspans = dcc->nspans;
+    size_t ncoeffs = nspans * (p + 1) * 4;
+    nurbs_CompiledCurveF *cc = (nurbs_CompiledCurveF *)nurbs__memAlloc(
+        sizeof(nurbs_CompiledCurveF) + (nspans + 1) * sizeof(double) +
+        ncoeffs * sizeof(float));
+    if (cc == NULL) {
+        nurbs__memFree(dcc);
+        return NULL;
+    }
+
+    cc->degree = data->degree;
+    cc->nspans = (uint32_t)nspans;
+    cc->breaks = (double *)(cc + 1);
+    cc->coeffs = (float *)(cc->breaks + nspans + 1);
+    memcpy(cc->breaks, dcc->breaks, (nspans + 1) * sizeof(double));
+
+    /* origin at the center of the control point bounding box */
+    const nurbs__Kernels *kernels = nurbs__kernels();
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    nurbs_Point *pts = (nurbs_Point *)nurbs__memScratchAlloc(
+        cv->npoints * sizeof(nurbs_Point));
+    if (pts == NULL) {
+        nurbs__memFree(cc);
+        nurbs__memFree(dcc);
+        return NULL;
+    }
+    kernels->unpack(cv->hpoints, cv->npoints, pts, NULL);
+    nurbs_Point lo = pts[0], hi = pts[0];
+    kernels->aabb(pts, cv->npoints, &lo, &hi);
+    nurbs__memScratchRelease(mark);
+    nurbs_Point o = nurbs__vecMul(nurbs__vecAdd(lo, hi), 0.5);
+    cc->origin = o;
+    cc->error = 0.0;
+
+    const double *dc = dcc->coeffs;
+    float *c = cc->coeffs;
+    size_t s = 0;
+    for (size_t kspan = p; kspan <= last; ++kspan) {
+        if (U[kspan] >= U[kspan + 1])
+            continue;
+
+        /* (h - w o, w) are the homogeneous coefficients relative to o */
+        double sxyz[3] = {0.0, 0.0, 0.0}, sw = 0.0;
+        for (size_t j = 0; j <= p; ++j) {
+            const double *dj = dc + 4 * j;
+            float *cj = c + 4 * j;
+            cj[0] = (float)(dj[0] - dj[3] * o.x);
+            cj[1] = (float)(dj[1] - dj[3] * o.y);
+            cj[2] = (float)(dj[2] - dj[3] * o.z);
+            cj[3] = (float)dj[3];
+            for (size_t d = 0; d < 3; ++d)
+                sxyz[d] += fabs(cj[d]);
+            sw += fabs(cj[3]);
+        }
+
+        /* radius and least weight of the span's Bezier points */
+        double radius = 0.0, wmin = INFINITY;
+        nurbs__modifySpanBezier(data, kspan, bezier);
+        for (size_t i = 0; i <= p; ++i) {
+            nurbs__Vec4 b = nurbs__vec4(bezier[4 * i], bezier[4 * i + 1],
+                                        bezier[4 * i + 2], bezier[4 * i + 3]);
+            radius = fmax(radius, nurbs__dist(nurbs__vec4Dehomogenize(b), o));
+            wmin = fmin(wmin, b.w);
+        }
+
+        double eh = k * eps * nurbs__vecNorm(nurbs__vec(sxyz[0], sxyz[1], sxyz[2]));
+        double ew = k * eps * sw;
+        double err = wmin > ew ? (eh + radius * ew) / (wmin - ew) : INFINITY;
+        cc->error = fmax(cc->error, err);
+
+        dc += (p + 1) * 4;
+        c += (p + 1) * 4;
+        ++s;
+    }
+    assert(s == nspans);
+
+    nurbs__memFree(dcc);
+    return cc;
+}
+
+void nurbs__evalCompiledPointF(const nurbs_CompiledCurveF *cc, size_t span,
+                               float t, float *xyz)
+{
+    size_t p = cc->degree;
+    const float *c = cc->coeffs + span * (p + 1) * 4;
+    float h[4];
+
+    for (size_t d = 0; d < 4; ++d)
+        h[d] = c[4 * p + d];
+    for (size_t j = p; j-- > 0;) {
+        for (size_t d = 0; d < 4; ++d)
+            h[d] = h[d] * t + c[4 * j + d];
+    }
+
+    xyz[0] = h[0] / h[3];
+    xyz[1] = h[1] / h[3];
+    xyz[2] = h[2] / h[3];
+}
+
+void nurbs__evalCompiledPointsF(const nurbs_CompiledCurveF *cc,
+                                const double *us, size_t n, float *xyz)
+{
+    assert(cc->nspans > 0);
+    const double *breaks = cc->breaks;
+    size_t last = cc->nspans - 1;
+    size_t span = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        double u = us[i];
+
+        /* stay in or step forward from the last span, else search */
+        if (u < breaks[span] || (span < last && u >= breaks[span + 2]) ||
+            (span == last && u > breaks[last + 1])) {
+            size_t lo = 0, hi = cc->nspans;
+            while (hi - lo > 1) {
+                size_t mid = (lo + hi) / 2;
+                if (u < breaks[mid])
+                    hi = mid;
+                else
+                    lo = mid;
+            }
+            span = lo;
+        }
+        else if (span < last && u >= breaks[span + 1]) {
+            ++span;
+        }
+
+        double t = (u - breaks[span]) / (breaks[span + 1] - breaks[span]);
+        nurbs__evalCompiledPointF(cc, span, (float)t, xyz + 3 * i);
     }
-    pa->weights = weights;
-}
\ No newline at end of file
+}
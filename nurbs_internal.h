@@ -28,6 +28,92 @@
 
 #define NURBS__EPSILON   (1e-10)
 #define NURBS__TOLERANCE (1e-6)
+#define NURBS__MAXDEGREE NURBS_MAXDEGREE
+#define NURBS__LANES     (8)
+#define NURBS__SPANWALK  (8)
+#define NURBS__KINDEXMIN (64)
+#define NURBS__ALIGN     (32)
+#define NURBS__SCRATCHCHUNK (64 * 1024)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NURBS__CASPTR(ptr, expected, desired)                              \
+    (_InterlockedCompareExchangePointer((void *volatile *)(ptr), (desired), \
+                                        (expected)) == (expected))
+#elif defined(__GNUC__)
+#define NURBS__CASPTR(ptr, expected, desired)                              \
+    __sync_bool_compare_and_swap((ptr), (expected), (desired))
+#else
+/* a plain compare and store would race between batch workers and lazy
+   index builders, so refuse to build rather than corrupt silently */
+#error "nurbs needs MSVC or GCC style atomic intrinsics"
+#endif
+
+#if defined(_MSC_VER)
+#define NURBS__CAS64(ptr, expected, desired)                                 \
+    (_InterlockedCompareExchange64((volatile long long *)(ptr),              \
+                                   (long long)(desired),                      \
+                                   (long long)(expected)) ==                  \
+     (long long)(expected))
+#define NURBS__LOAD64(ptr) \
+    ((uint64_t)_InterlockedCompareExchange64((volatile long long *)(ptr), 0, 0))
+#elif defined(__GNUC__)
+#define NURBS__CAS64(ptr, expected, desired) \
+    __sync_bool_compare_and_swap((ptr), (expected), (desired))
+#define NURBS__LOAD64(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
+#if defined(_MSC_VER)
+#define NURBS__THREADLOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define NURBS__THREADLOCAL _Thread_local
+#else
+#define NURBS__THREADLOCAL __thread
+#endif
+
+#include "nurbs_vec.h"
+#include <string.h>
+
+/*
+ * Output window of the caller-buffer API variants. Producers pass every
+ * element of a result to nurbs__outPush, which counts it and stores the
+ * ones with index in [first, first + cap) at buf.
+ */
+typedef struct {
+    unsigned char *buf; /* caller buffer */
+    size_t size;        /* element size */
+    size_t first;       /* index of the element stored at buf[0] */
+    size_t cap;         /* capacity of buf in elements */
+    size_t count;       /* elements produced so far */
+} nurbs__Out;
+
+static inline void nurbs__outInit(nurbs__Out *out, void *buf, size_t size,
+                                  size_t first, size_t cap)
+{
+    out->buf = (unsigned char *)buf;
+    out->size = size;
+    out->first = first;
+    out->cap = buf ? cap : 0;
+    out->count = 0;
+}
+
+/* whether the next element is stored, producers skip computing it if not */
+static inline int nurbs__outWanted(const nurbs__Out *out)
+{
+    return out->count >= out->first && out->count - out->first < out->cap;
+}
+
+static inline void nurbs__outSkip(nurbs__Out *out, size_t n)
+{
+    out->count += n;
+}
+
+static inline void nurbs__outPush(nurbs__Out *out, const void *elem)
+{
+    size_t i = out->count++;
+    if (i >= out->first && i - out->first < out->cap)
+        memcpy(out->buf + (i - out->first) * out->size, elem, out->size);
+}
 
 typedef struct {
     nurbs_Point point0;
@@ -36,61 +122,351 @@ typedef struct {
     double u1;
 } nurbs__CurveCurveIntersection;
 
-double nurbs__dist(const nurbs_Point *p1, const nurbs_Point *p2);
+/* ----------------------------------- Mem ---------------------------------- */
+
+/**
+ * \brief Set the allocator used when no thread allocator is set
+ *
+ * \param allocator The allocator, NULL for malloc and free
+ * \return void
+ */
+void nurbs__memSetGlobal(const nurbs_Allocator *allocator);
+
+/**
+ * \brief Set the allocator of the calling thread
+ *
+ * \param allocator The allocator, NULL to use the global one
+ * \return The previous thread allocator
+ */
+const nurbs_Allocator *nurbs__memSetThread(const nurbs_Allocator *allocator);
+
+/**
+ * \brief Allocate from the current allocator
+ *
+ * The block is NURBS__ALIGN aligned and records its allocator in a header
+ * right below it, so nurbs__memRealloc and nurbs__memFree always return it
+ * to where it came from, whatever the current allocator is by then.
+ *
+ * \param size The size in bytes
+ * \return The block, NULL if out of memory
+ */
+void *nurbs__memAlloc(size_t size);
+
+/**
+ * \brief Allocate a zeroed array from the current allocator
+ *
+ * \param n The number of elements
+ * \param size The element size
+ * \return The block, NULL if out of memory or on overflow
+ */
+void *nurbs__memCalloc(size_t n, size_t size);
+
+/**
+ * \brief Resize a block, keeping it with its allocator
+ *
+ * \param ptr The block, NULL to allocate
+ * \param size The new size in bytes
+ * \return The block, NULL if out of memory, ptr is then still valid
+ */
+void *nurbs__memRealloc(void *ptr, size_t size);
+
+/**
+ * \brief Free a block from nurbs__memAlloc
+ *
+ * \param ptr The block, may be NULL
+ * \return void
+ */
+void nurbs__memFree(void *ptr);
+
+/* position in the thread scratch arena, see nurbs__memScratchMark */
+typedef struct {
+    struct nurbs__MemChunk *chunk;
+    size_t used;
+} nurbs__MemMark;
+
+/**
+ * \brief Remember the top of the calling thread's scratch arena
+ *
+ * Temporaries of an algorithm come from nurbs__memScratchAlloc between a
+ * mark and its release. The chunks stay cached on the thread, so repeated
+ * calls stop touching the allocator once the arena is large enough.
+ *
+ * \return The mark to pass to nurbs__memScratchRelease
+ */
+nurbs__MemMark nurbs__memScratchMark(void);
+
+/**
+ * \brief Drop all scratch allocated since a mark
+ *
+ * Marks nest, release them in reverse order.
+ *
+ * \param mark The mark
+ * \return void
+ */
+void nurbs__memScratchRelease(nurbs__MemMark mark);
+
+/**
+ * \brief Bump allocate from the calling thread's scratch arena
+ *
+ * \param size The size in bytes
+ * \return A NURBS__ALIGN aligned block, NULL if out of memory
+ */
+void *nurbs__memScratchAlloc(size_t size);
+
+/**
+ * \brief Free the cached scratch chunks above the top of the arena
+ *
+ * \return void
+ */
+void nurbs__memScratchTrim(void);
 
 /* ---------------------------------- Make ---------------------------------- */
 
-nurbs_CurveData *nurbs__makeEllipseArc(const nurbs_Point *center,
-                                       const nurbs_Vector *xaxis,
-                                       const nurbs_Vector *yaxis,
-                                       double minAngle, double maxAngle);
+/**
+ * \brief Size of the block nurbs__makeLayout lays a curve out in
+ *
+ * \param size The size of the curve struct, at least sizeof(nurbs_Curve)
+ * \param np The number of control points
+ * \param nknots The number of knots
+ * \return The size in bytes, a multiple of NURBS__ALIGN
+ */
+size_t nurbs__makeSize(size_t size, size_t np, size_t nknots);
 
-nurbs_CurveData *nurbs__makeArc(const nurbs_Point *center,
-                                const nurbs_Vector *xaxis,
-                                const nurbs_Vector *yaxis, double radius,
-                                double minAngle, double maxAngle);
+/**
+ * \brief Lay a curve out in caller memory, see nurbs__makeAlloc
+ *
+ * \param mem NURBS__ALIGN aligned memory of nurbs__makeSize bytes
+ * \param size The size of the curve struct, at least sizeof(nurbs_Curve)
+ * \param degree The degree of the curve
+ * \param np The number of control points
+ * \param nknots The number of knots
+ * \return nurbs_Curve* the curve at the start of mem
+ */
+nurbs_Curve *nurbs__makeLayout(void *mem, size_t size, uint8_t degree,
+                               size_t np, size_t nknots);
 
-nurbs_CurveData *nurbs__makePolyline(const nurbs_Point *points, size_t np);
+/**
+ * \brief Allocate a curve with its data in one NURBS__ALIGN aligned block
+ *
+ * The block holds the curve struct, nurbs_CurveData, nurbs_PointArray, then
+ * the homogeneous control points and the knots, each array starting on an
+ * aligned boundary.
+ * Only the lazily built knot index lives outside. The curve type is
+ * NURBS_CURVE_NURBS and the arrays are left uninitialized.
+ *
+ * \param size The size of the curve struct, at least sizeof(nurbs_Curve)
+ * \param degree The degree of the curve
+ * \param np The number of control points
+ * \param nknots The number of knots
+ * \return nurbs_Curve* NULL if out of memory
+ */
+nurbs_Curve *nurbs__makeAlloc(size_t size, uint8_t degree, size_t np,
+                              size_t nknots);
 
-nurbs_CurveData *nurbs__makeRationalBezier(const nurbs_Point *points, size_t np,
-                                           double *weights, size_t nw);
+/**
+ * \brief Free a curve from nurbs__makeAlloc along with its knot index
+ */
+void nurbs__makeFree(nurbs_Curve *curve);
 
-/* ---------------------------------- Vec ----------------------------------- */
+/**
+ * \brief Number of rational quadratic segments of an elliptical arc
+ *
+ * \param minAngle The start angle
+ * \param maxAngle The end angle, raised to a full turn past minAngle if it
+ * is below it
+ * \return 1 to 4, one segment per started quarter turn
+ */
+size_t nurbs__makeEllipseArcSegments(double minAngle, double *maxAngle);
 
-double nurbs__vecNorm_(const double *v);
-double nurbs__vecNormSquared_(const double *a);
-double *nurbs__vecAdd_(const double *v1, const double *v2);
-double *nurbs__vecMul_(const double *v, double a);
-double *nurbs__vecDiv_(const double *v, double a);
-double *nurbs__vecSub_(const double *v1, const double *v2);
-int nurbs__vecIsZero_(const double *v);
-double *nurbs__vecNormalized_(const double *v);
-double nurbs__vecDot_(const double *v1, const double *v2);
-double *nurbs__vecOnRay_(const double *origin, const double *dir, double u);
+/**
+ * \brief Write the knots and control points of an elliptical arc
+ *
+ * Needs only the sine and cosine of the start, end and half segment angles,
+ * the points in between follow by rotation and the tangent intersections in
+ * closed form.
+ *
+ * \param center The center
+ * \param xaxis The x axis, its length is the x radius
+ * \param yaxis The y axis, its length is the y radius
+ * \param minAngle The start angle
+ * \param maxAngle The end angle, as returned by
+ * nurbs__makeEllipseArcSegments
+ * \param numArcs The number of segments
+ * \param knots Output 2 numArcs + 4 knots
+ * \param hpoints Output 2 numArcs + 1 homogeneous control points
+ * \return void
+ */
+void nurbs__makeEllipseArcFill(const nurbs_Point *center,
+                               const nurbs_Vector *xaxis,
+                               const nurbs_Vector *yaxis, double minAngle,
+                               double maxAngle, size_t numArcs, double *knots,
+                               nurbs_HPoint *hpoints);
 
-#define nurbs__vecNorm(v)        (nurbs__vecNorm_((const double *)(v)))
+nurbs_Curve *nurbs__makeEllipseArc(size_t size, const nurbs_Point *center,
+                                   const nurbs_Vector *xaxis,
+                                   const nurbs_Vector *yaxis, double minAngle,
+                                   double maxAngle);
 
-#define nurbs__vecNormSquared(v) (nurbs__vecNormalized_((const double *)(v)))
+nurbs_Curve *nurbs__makeArc(size_t size, const nurbs_Point *center,
+                            const nurbs_Vector *xaxis,
+                            const nurbs_Vector *yaxis, double radius,
+                            double minAngle, double maxAngle);
 
-#define nurbs__vecAdd(v1, v2) \
-    (nurbs__vecAdd_((const double *)(v1), (const double *)(v2)))
+nurbs_Curve *nurbs__makePolyline(size_t size, const nurbs_Point *points,
+                                 size_t np);
 
-#define nurbs__vecMul(v, a) (nurbs__vecMul_((const double *)(v), a))
+/**
+ * \brief Curve from degree, control points, knots and weights
+ *
+ * \param degree The degree of the curve
+ * \param cv The cartesian control points
+ * \param ncv The number of control points
+ * \param knots The nondecreasing knots, ncv + degree + 1 of them
+ * \param nknots The number of knots
+ * \param weights The positive weights, NULL for all 1
+ * \return nurbs_Curve* NULL for invalid input or out of memory
+ */
+nurbs_Curve *nurbs__makeKCW(uint8_t degree, const nurbs_Point *cv, size_t ncv,
+                           const double *knots, size_t nknots,
+                           const double *weights);
+
+nurbs_Curve *nurbs__makeRationalBezier(size_t size, const nurbs_Point *points,
+                                       size_t np, double *weights, size_t nw);
+
+/**
+ * \brief Deep copy of curve data, the knot index is rebuilt lazily
+ *
+ * \param data The curve data to copy
+ * \return nurbs_Curve* a NURBS_CURVE_NURBS curve, NULL if out of memory
+ */
+nurbs_Curve *nurbs__makeCopy(const nurbs_CurveData *data);
+
+/**
+ * \brief Global interpolation through points
+ *
+ * Chord length parameters and knots by averaging, see The NURBS Book 9.2.1.
+ * The collocation system is solved with a banded LU decomposition, so the
+ * cost is O(np * degree^2) time and O(np * degree) memory.
+ *
+ * \param points The points to interpolate
+ * \param np The number of points, greater than degree
+ * \param degree The degree of the curve
+ * \return nurbs_Curve* NULL for degenerate input or out of memory
+ */
+nurbs_Curve *nurbs__makeInterpolated(const nurbs_Point *points, size_t np,
+                                     uint8_t degree);
+
+/*
+ * Accumulated normal equations of a least squares fit, A = sum N N^T and
+ * B = sum N q^T over the samples q. A is symmetric with half bandwidth degree
+ * and only its lower band is kept. Samples are shifted by the first one so
+ * the residual can be recovered from the sums without cancellation.
+ */
+struct nurbs__CurveFitter {
+    uint8_t degree;     /* degree of curve */
+    uint32_t ncv;       /* number of control points */
+    uint32_t nknots;    /* number of knots */
+    double *knots;      /* clamped uniform knots */
+    double *ata;        /* ncv * (degree + 1) lower band of A */
+    double *atb;        /* ncv * 3 right-hand sides B */
+    double qq;          /* sum of squared shifted samples */
+    size_t nsamples;    /* number of samples fed */
+    nurbs_Point origin; /* shift applied to the samples */
+    size_t span;        /* span of the last sample, search hint */
+};
 
-#define nurbs__vecDiv(v, a) (nurbs__vecDiv_((const double *)(v), a))
+nurbs_CurveFitter *nurbs__makeFitterNew(uint8_t degree, uint32_t ncv,
+                                        double umin, double umax);
 
-#define nurbs__vecSub(v1, v2) \
-    (nurbs__vecSub_((const double *)(v1), (const double *)(v2)))
+void nurbs__makeFitterAdd(nurbs_CurveFitter *fitter, const nurbs_Point *points,
+                          const double *us, size_t n);
 
-#define nurbs__vecIsZero(v)     (nurbs__vecIsZero_((const double *)(v)))
+/**
+ * \brief Solve the normal equations of a fitter
+ *
+ * A light first difference penalty, relative to NURBS__EPSILON, keeps control
+ * points of spans without samples determined.
+ *
+ * \param fitter The fitter
+ * \param rms Output root mean square residual, may be NULL
+ * \return nurbs_Curve* NULL without samples or out of memory
+ */
+nurbs_Curve *nurbs__makeFitterSolve(const nurbs_CurveFitter *fitter,
+                                    double *rms);
 
-#define nurbs__vecNormalized(v) (nurbs__vecNormalized_((const double *)(v)))
+/**
+ * \brief Solve a fitter with the fewest control points meeting a tolerance
+ *
+ * Every uniform knot vector whose segments divide those of the fitter is
+ * nested in it, so its normal equations are projected from the accumulated
+ * ones without the samples. They are tried from the fewest segments up and
+ * the first fit with a residual within tol is returned, else the full one.
+ *
+ * \param fitter The fitter
+ * \param tol The root mean square residual to meet, positive
+ * \param rms Output root mean square residual of the result, may be NULL
+ * \return nurbs_Curve* NULL without samples, for a tol that is not positive
+ * or out of memory
+ */
+nurbs_Curve *nurbs__makeFitterSolveTol(const nurbs_CurveFitter *fitter,
+                                       double tol, double *rms);
 
-#define nurbs__vecDot(v1, v2) \
-    (nurbs__vecDot_((const double *)(v1), (const double *)(v2)))
+void nurbs__makeFitterFree(nurbs_CurveFitter *fitter);
 
-#define nurbs__vecOnRay(origin, dir, u) \
-    (nurbs__vecOnRay_((const double *)(origin), (const double *)(dir), u))
+/**
+ * \brief Append elliptical arcs to a curve store
+ *
+ * \param store The store
+ * \param type The NURBS_CURVE_* type to record
+ * \param centers The centers
+ * \param xaxes The x axes, their lengths are the x radii if radii is NULL
+ * \param yaxes The y axes, their lengths are the y radii if radii is NULL
+ * \param radii The radii of circular arcs, or NULL
+ * \param minAngles The start angles, NULL with maxAngles for full turns
+ * \param maxAngles The end angles
+ * \param n The number of arcs
+ * \param handles Output n handles, or NULL
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs__makeStoreEllipseArcs(nurbs_CurveStore *store, int type,
+                                const nurbs_Point *centers,
+                                const nurbs_Vector *xaxes,
+                                const nurbs_Vector *yaxes, const double *radii,
+                                const double *minAngles,
+                                const double *maxAngles, size_t n,
+                                nurbs_CurveHandle *handles);
+
+/**
+ * \brief Append line segments to a curve store
+ *
+ * \param store The store
+ * \param starts The start points
+ * \param ends The end points
+ * \param n The number of lines
+ * \param handles Output n handles, or NULL
+ * \return NURBS_TRUE, NURBS_FALSE if out of memory
+ */
+int nurbs__makeStoreLines(nurbs_CurveStore *store, const nurbs_Point *starts,
+                          const nurbs_Point *ends, size_t n,
+                          nurbs_CurveHandle *handles);
+
+/* --------------------------------- Analyze -------------------------------- */
+
+/**
+ * \brief Find the curve parameter closest to a point
+ *
+ * Samples every non empty span 2 (degree + 1) times with the batch
+ * evaluator, then refines the nearest sample with Newton iterations on
+ * C'(u).(C(u) - P) = 0, bracketed by its neighbouring samples. The workspace
+ * comes from the thread scratch arena.
+ *
+ * \param data The curve data
+ * \param point The point
+ * \param closest Output closest curve point, or NULL
+ * \return The parameter, NAN if out of memory
+ */
+double nurbs__analyzeCloseParam(const nurbs_CurveData *data,
+                                const nurbs_Point *point, nurbs_Point *closest);
 
 /* -------------------------------- Intersect ------------------------------- */
 
@@ -98,27 +474,908 @@ int nurbs__intersecectRay(const nurbs_Point *a0, const nurbs_Point *a,
                           const nurbs_Point *b0, const nurbs_Point *b,
                           nurbs__CurveCurveIntersection *intersection);
 
+/* --------------------------------- Modify --------------------------------- */
+
+/**
+ * \brief Extract the Bezier control points of one knot span
+ *
+ * \param data The curve data
+ * \param span The index of a non empty knot span
+ * \param bezier Output array of degree + 1 homogeneous (wx, wy, wz, w) points
+ * \return void
+ */
+void nurbs__modifySpanBezier(const nurbs_CurveData *data, size_t span,
+                             double *bezier);
+
+/* --------------------------------- Divide --------------------------------- */
+
+/**
+ * \brief Arc length of the curve between two parameters
+ *
+ * Integrates the speed span by span with adaptive Gauss-Legendre quadrature.
+ *
+ * \param data The curve data
+ * \param a The start parameter
+ * \param b The end parameter, no less than a
+ * \return The arc length
+ */
+double nurbs__divideLength(const nurbs_CurveData *data, double a, double b);
+
+/**
+ * \brief Parameter at an arc length from the start of the curve
+ *
+ * \param data The curve data
+ * \param len The arc length, clamped to the curve
+ * \return The parameter
+ */
+double nurbs__divideParamAtLength(const nurbs_CurveData *data, double len);
+
+/**
+ * \brief Divide the curve into segments of equal arc length
+ *
+ * Produces divisions + 1 samples, the last one at the end of the domain.
+ *
+ * \param data The curve data
+ * \param divisions The number of segments
+ * \param out The nurbs_CurveSample output window
+ * \return NURBS_TRUE on success, NURBS_FALSE if divisions is 0 or out of
+ * memory
+ */
+int nurbs__divideEqualArcLength(const nurbs_CurveData *data, size_t divisions,
+                                nurbs__Out *out);
+
+/**
+ * \brief Divide the curve into segments of a given arc length
+ *
+ * Produces a sample every arclength from the start, the remainder of the
+ * curve after the last one is shorter than arclength.
+ *
+ * \param data The curve data
+ * \param arclength The segment length
+ * \param out The nurbs_CurveSample output window
+ * \return NURBS_TRUE on success, NURBS_FALSE if arclength is not positive or
+ * out of memory
+ */
+int nurbs__divideArcLength(const nurbs_CurveData *data, double arclength,
+                           nurbs__Out *out);
+
+/**
+ * \brief Bytes needed to split the curve into caller memory
+ *
+ * \param data The curve data
+ * \param u The split parameter
+ * \param size The size of each curve object
+ * \param nleft Output number of control points of the left curve
+ * \param nright Output number of control points of the right curve
+ * \return The bytes for both curves and their knot indices, 0 if u is not
+ * inside the domain
+ */
+size_t nurbs__divideSplitSize(const nurbs_CurveData *data, double u,
+                              size_t size, size_t *nleft, size_t *nright);
+
+/**
+ * \brief Split the curve into two curves laid out in caller memory
+ *
+ * \param data The curve data
+ * \param u The split parameter
+ * \param mem NURBS__ALIGN aligned memory of nurbs__divideSplitSize bytes
+ * \param curves Output left and right curves, they live in mem
+ * \return NURBS_TRUE on success, NURBS_FALSE if u is not inside the domain
+ */
+int nurbs__divideSplit(const nurbs_CurveData *data, double u, void *mem,
+                       nurbs_Curve *curves[2]);
+
+/**
+ * \brief Split the curve into two allocated curves
+ *
+ * \param data The curve data
+ * \param u The split parameter
+ * \param curves Output left and right curves, freed with nurbs__makeFree
+ * \return NURBS_TRUE on success, NURBS_FALSE if u is not inside the domain or
+ * out of memory
+ */
+int nurbs__divideSplitAlloc(const nurbs_CurveData *data, double u,
+                            nurbs_Curve *curves[2]);
+
+/* ---------------------------------- Tess ---------------------------------- */
+
+/**
+ * \brief Tessellate one knot span adaptively
+ *
+ * Subdivides the Bezier form of the span on an explicit stack until every
+ * piece meets the tolerance and emits the start point of each piece, left to
+ * right. The end point of the span is left to the next span or the caller.
+ *
+ * \param data The curve data
+ * \param span The index of a non empty knot span
+ * \param tol The tolerance, chord positive and angle not negative
+ * \param out The nurbs_Point output window
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__tessSpan(const nurbs_CurveData *data, size_t span,
+                    const nurbs_TessTolerance *tol, nurbs__Out *out);
+
+/**
+ * \brief Tessellate the curve adaptively
+ *
+ * Every non empty knot span in turn, followed by the end point.
+ *
+ * \param data The curve data
+ * \param tol The tolerance
+ * \param out The nurbs_Point output window
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs__tessCurve(const nurbs_CurveData *data,
+                     const nurbs_TessTolerance *tol, nurbs__Out *out);
+
+/**
+ * \brief Tessellate the part of the curve inside a clip region
+ *
+ * As nurbs__tessCurve, except that spans and pieces whose control points lie
+ * behind a plane of the region are dropped before they are refined. The
+ * points left form runs, each a polyline from the start of its first piece
+ * to the end of its last. Every point is one nurbs__tessCurve produces.
+ *
+ * \param data The curve data
+ * \param tol The tolerance
+ * \param clip The clip region
+ * \param points The nurbs_Point output window
+ * \param runs The size_t output window, the index of the first point of each
+ * run followed by the number of points
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs__tessClip(const nurbs_CurveData *data,
+                    const nurbs_TessTolerance *tol,
+                    const nurbs_ClipRegion *clip, nurbs__Out *points,
+                    nurbs__Out *runs);
+
+/**
+ * \brief Create a tessellation iterator
+ *
+ * \param data The curve data, it must outlive the iterator
+ * \param tol The tolerance
+ * \return The iterator, NULL if the tolerance is invalid or out of memory
+ */
+nurbs_TessIterator *nurbs__tessIterNew(const nurbs_CurveData *data,
+                                       const nurbs_TessTolerance *tol);
+
+/**
+ * \brief Produce the next points of a tessellation
+ *
+ * The points are those of nurbs__tessCurve, in order.
+ *
+ * \param it The iterator
+ * \param points Output buffer of cap points
+ * \param cap The capacity of the buffer
+ * \param n Output number of points produced, less than cap only once the
+ * tessellation is complete
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__tessIterNext(nurbs_TessIterator *it, nurbs_Point *points,
+                        size_t cap, size_t *n);
+
+void nurbs__tessIterFree(nurbs_TessIterator *it);
+
+/**
+ * \brief Tessellate the curve remembering the points of each knot span
+ *
+ * \param data The curve data, it must outlive the tessellation
+ * \param tol The tolerance
+ * \return The tessellation, NULL if the tolerance is invalid or out of memory
+ */
+nurbs_Tessellation *nurbs__tessResultNew(const nurbs_CurveData *data,
+                                         const nurbs_TessTolerance *tol);
+
+/**
+ * \brief Re-tessellate the knot spans of changed control points
+ *
+ * \param t The tessellation
+ * \param first The first changed control point
+ * \param n The number of changed control points
+ * \param span0 Output first re-tessellated span, may be NULL
+ * \param span1 Output end of the re-tessellated spans, may be NULL
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__tessResultUpdate(nurbs_Tessellation *t, size_t first, size_t n,
+                            size_t *span0, size_t *span1);
+
+size_t nurbs__tessResultSpans(const nurbs_Tessellation *t);
+
+const nurbs_Point *nurbs__tessResultSpan(const nurbs_Tessellation *t,
+                                         size_t span, size_t *n);
+
+/**
+ * \brief Copy a window of the points, see nurbs__Out
+ *
+ * \param t The tessellation
+ * \param points Output buffer of cap points, may be NULL
+ * \param first The index of the first point to copy
+ * \param cap The capacity of the buffer
+ * \return The number of points
+ */
+size_t nurbs__tessResultPoints(const nurbs_Tessellation *t,
+                               nurbs_Point *points, size_t first, size_t cap);
+
+void nurbs__tessResultFree(nurbs_Tessellation *t);
+
+/* ---------------------------------- Cache --------------------------------- */
+
+/**
+ * \brief Create a tessellation cache
+ *
+ * \param budget The most bytes the entries may hold
+ * \return The cache, NULL if out of memory
+ */
+nurbs_TessCache *nurbs__cacheNew(size_t budget);
+
+/**
+ * \brief Get the tessellation of a curve from the cache
+ *
+ * Tolerances are bucketed into levels, the largest power of two up to tol,
+ * and the curve is tessellated at that. A missing level is derived from a
+ * cached finer one by simplifying it within the difference of the two
+ * tolerances, or tessellated. The least recently used entries are evicted
+ * past the budget, the returned one is kept until the next call.
+ *
+ * \param cache The cache
+ * \param curve The curve, the key of the entry
+ * \param tol The chord height tolerance
+ * \param n Output number of points
+ * \return The points, valid until the next call on the cache, NULL if tol
+ * is not positive and finite or out of memory
+ */
+const nurbs_Point *nurbs__cacheGet(nurbs_TessCache *cache,
+                                   const nurbs_Curve *curve, double tol,
+                                   size_t *n);
+
+/**
+ * \brief Drop the entries of a curve
+ *
+ * \param cache The cache
+ * \param curve The curve, NULL for all of them
+ * \return void
+ */
+void nurbs__cacheInvalidate(nurbs_TessCache *cache, const nurbs_Curve *curve);
+
+void nurbs__cacheSetBudget(nurbs_TessCache *cache, size_t budget);
+
+void nurbs__cacheStats(const nurbs_TessCache *cache,
+                       nurbs_TessCacheStats *stats);
+
+void nurbs__cacheFree(nurbs_TessCache *cache);
+
+/* ---------------------------------- Batch --------------------------------- */
+
+/**
+ * \brief Resolve a requested thread count
+ *
+ * \param nthreads The requested count, 0 for one per online processor
+ * \return The thread count, at least 1
+ */
+unsigned nurbs__batchThreads(unsigned nthreads);
+
+/**
+ * \brief Run fn on nthreads threads and wait for all of them
+ *
+ * The calling thread is worker 0. The other threads allocate from the global
+ * allocator, a thread allocator such as a request arena is not shared, and
+ * trim their scratch arena when they are done. The worker
+ * of a thread that fails to start runs on the calling thread after worker 0,
+ * so every worker index runs exactly once.
+ *
+ * \param nthreads The number of workers
+ * \param fn The function, called once per worker with its index
+ * \param ctx The context passed to fn
+ * \return NURBS_TRUE if fn ran, NURBS_FALSE if out of memory
+ */
+int nurbs__batchRun(unsigned nthreads, void (*fn)(void *ctx, unsigned worker),
+                    void *ctx);
+
+/**
+ * \brief Tessellate many curves in parallel
+ *
+ * Workers start on even shares of the curves and steal half of the remaining
+ * share of another worker when theirs runs out. Each curve is tessellated as
+ * by nurbs__tessCurve, and the output is in curve order, so it does not
+ * depend on the thread count.
+ *
+ * \param curves The curves
+ * \param n The number of curves
+ * \param tol The tolerance
+ * \param nthreads The number of threads, 0 for one per processor
+ * \param points Output concatenated points, freed with nurbs__memFree
+ * \param offsets Output n + 1 offsets, curve i has the points from
+ * offsets[i] up to offsets[i + 1], freed with nurbs__memFree
+ * \return NURBS_TRUE on success, NURBS_FALSE if the tolerance is invalid or
+ * out of memory
+ */
+int nurbs__batchTessellate(const nurbs_Curve *const *curves, size_t n,
+                           const nurbs_TessTolerance *tol, unsigned nthreads,
+                           nurbs_Point **points, size_t **offsets);
+
 /* ---------------------------------- Eval ---------------------------------- */
 
 /**
  * \brief Transform a 1d array of points into their homogeneous equivalents
  *
- * \param pa The array of points
- * \param weights The array of weights
+ * \param pa The array of points, its hpoints are filled
+ * \param points The cartesian points, pa->npoints of them
+ * \param weights The array of weights, NULL for all 1
+ * \return void
+ */
+void nurbs__evalHomogenize1d(nurbs_PointArray *pa, const nurbs_Point *points,
+                             const double *weights);
+
+/**
+ * \brief Find the knot span index of a parameter by binary search
+ *
+ * \param degree The degree of the curve
+ * \param knots The knot vector
+ * \param nknots The number of knots
+ * \param u The parameter
+ * \return The span index, clamped to [degree, nknots - degree - 2]
+ */
+size_t nurbs__evalKnotSpan(uint8_t degree, const double *knots,
+                           uint32_t nknots, double u);
+
+/**
+ * \brief Find the knot span index of a parameter starting from a nearby span
+ *
+ * Walks at most NURBS__SPANWALK spans from the hint in either direction and
+ * falls back to binary search, so monotone sweeps cost amortized O(1).
+ *
+ * \param degree The degree of the curve
+ * \param knots The knot vector
+ * \param nknots The number of knots
+ * \param u The parameter
+ * \param hint A span index close to the one of u
+ * \return The span index, clamped to [degree, nknots - degree - 2]
+ */
+size_t nurbs__evalKnotSpanFrom(uint8_t degree, const double *knots,
+                               uint32_t nknots, double u, size_t hint);
+
+/*
+ * Uniform bucket grid over the curve domain. Each bucket stores the span that
+ * contains its left end, so a lookup is one multiply plus a short walk.
+ */
+struct nurbs__KnotIndex {
+    double umin;     /* domain start */
+    double scale;    /* buckets per unit parameter */
+    size_t nbuckets; /* number of buckets */
+    uint32_t span[]; /* span at the start of each bucket */
+};
+
+/**
+ * \brief Build the span lookup table of a curve
+ *
+ * \param data The curve data, with at least NURBS__KINDEXMIN spans
+ * \return The table, released with nurbs__memFree, NULL if out of memory
+ */
+struct nurbs__KnotIndex *nurbs__evalBuildKnotIndex(const nurbs_CurveData *data);
+
+/**
+ * \brief Size of the span lookup table of a curve
+ *
+ * \param data The curve data
+ * \return The size in bytes, 0 for curves under NURBS__KINDEXMIN spans
+ */
+size_t nurbs__evalKnotIndexSize(const nurbs_CurveData *data);
+
+/**
+ * \brief Build the span lookup table of a curve in caller memory
+ *
+ * \param data The curve data, with at least NURBS__KINDEXMIN spans
+ * \param mem Memory of nurbs__evalKnotIndexSize bytes
+ * \return The table at the start of mem
+ */
+struct nurbs__KnotIndex *nurbs__evalFillKnotIndex(const nurbs_CurveData *data,
+                                                  void *mem);
+
+/**
+ * \brief Find the knot span index of a parameter on a curve
+ *
+ * Curves with at least NURBS__KINDEXMIN spans get a struct nurbs__KnotIndex
+ * on first use, which makes the lookup O(1) for random access. Building the
+ * index is safe against concurrent lookups on the same curve.
+ *
+ * \param data The curve data
+ * \param u The parameter
+ * \return The span index, clamped to [degree, nknots - degree - 2]
+ */
+size_t nurbs__evalFindSpan(const nurbs_CurveData *data, double u);
+
+/**
+ * \brief Compute the non-vanishing basis functions at a parameter
+ *
+ * \param span The knot span index of u
+ * \param u The parameter
+ * \param degree The degree of the curve
+ * \param knots The knot vector
+ * \param N Output array of degree + 1 basis function values
+ * \return void
+ */
+void nurbs__evalBasisFunctions(size_t span, double u, uint8_t degree,
+                               const double *knots, double *N);
+
+/**
+ * \brief Compute the non-vanishing basis functions and their first
+ * derivatives at a parameter
+ *
+ * \param span The knot span index of u
+ * \param u The parameter
+ * \param degree The degree of the curve
+ * \param knots The knot vector
+ * \param N Output array of degree + 1 basis function values
+ * \param dN Output array of degree + 1 first derivatives
+ * \return void
+ */
+void nurbs__evalBasisFunctionsD1(size_t span, double u, uint8_t degree,
+                                 const double *knots, double *N, double *dN);
+
+/**
+ * \brief Compute the non-vanishing basis functions and their derivatives
+ *
+ * \param span The knot span index of u
+ * \param u The parameter
+ * \param degree The degree of the curve
+ * \param n The number of derivatives, at most degree
+ * \param knots The knot vector
+ * \param ders Output (n + 1) x (degree + 1) array, row k holds the k-th
+ *        derivatives
+ * \return void
+ */
+void nurbs__evalDersBasisFunctions(size_t span, double u, uint8_t degree,
+                                   size_t n, const double *knots, double *ders);
+
+/**
+ * \brief Compute the derivatives of a rational curve
+ *
+ * \param data The curve data
+ * \param u The parameter
+ * \param n The number of derivatives
+ * \param ck Output array of n + 1 vectors, ck[0] is the point itself
+ * \return void
+ */
+void nurbs__evalCurveDerivatives(const nurbs_CurveData *data, double u,
+                                 size_t n, nurbs_Vector *ck);
+
+/**
+ * \brief Evaluate a point on a rational curve
+ *
+ * \param data The curve data
+ * \param u The parameter
+ * \return The point on the curve
+ */
+nurbs_Point nurbs__evalCurvePoint(const nurbs_CurveData *data, double u);
+
+/**
+ * \brief Evaluate many points on a rational curve into SoA buffers
+ *
+ * \param data The curve data
+ * \param us The parameters, sorted or unsorted
+ * \param n The number of parameters
+ * \param x,y,z Output arrays of n coordinates
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__evalCurvePoints(const nurbs_CurveData *data, const double *us,
+                           size_t n, double *x, double *y, double *z);
+
+/**
+ * \brief Move a cursor to a parameter and evaluate the curve there
+ *
+ * \param cursor The cursor
+ * \param u The parameter
+ * \param pt Output point
+ * \param d1 Output first derivative, may be NULL
+ * \return void
+ */
+void nurbs__evalCursorPoint(nurbs_CurveCursor *cursor, double u,
+                            nurbs_Point *pt, nurbs_Vector *d1);
+
+/**
+ * \brief Convert a curve into its compiled per span power basis form
+ *
+ * \param data The curve data
+ * \return The compiled curve in a single allocation, NULL if out of memory
+ * or if the curve has no nonzero length span
+ */
+nurbs_CompiledCurve *nurbs__evalCompileCurve(const nurbs_CurveData *data);
+
+/**
+ * \brief Evaluate a compiled curve
+ *
+ * \param cc The compiled curve
+ * \param u The parameter
+ * \param pt Output point
+ * \param d1 Output first derivative, may be NULL
+ * \return void
+ */
+void nurbs__evalCompiledPoint(const nurbs_CompiledCurve *cc, double u,
+                              nurbs_Point *pt, nurbs_Vector *d1);
+
+/**
+ * \brief Convert a curve into single precision per span power basis form
+ *
+ * The error bound of a span comes from writing a vertex as
+ * (h + dh) / (w + dw): with the coefficient sums S of the span,
+ * |dh| <= k eps S_xyz and |dw| <= k eps S_w, k = 3 degree + 4, eps = 2^-24,
+ * so the vertex error is at most (k eps S_xyz + R k eps S_w) / (wmin - k eps
+ * S_w), with R and wmin the radius and least weight of its Bezier points.
+ *
+ * \param data The curve data
+ * \return The compiled curve in a single allocation, NULL if out of memory
+ * or if the curve has no nonzero length span
+ */
+nurbs_CompiledCurveF *nurbs__evalCompileCurveF(const nurbs_CurveData *data);
+
+/**
+ * \brief Evaluate a single precision compiled curve at one local parameter
+ *
+ * \param cc The compiled curve
+ * \param span The span index
+ * \param t The local parameter in [0, 1]
+ * \param xyz Output vertex relative to cc->origin
+ * \return void
+ */
+void nurbs__evalCompiledPointF(const nurbs_CompiledCurveF *cc, size_t span,
+                               float t, float *xyz);
+
+/**
+ * \brief Evaluate a single precision compiled curve at many parameters
+ *
+ * \param cc The compiled curve
+ * \param us The parameters
+ * \param n The number of parameters
+ * \param xyz Output interleaved vertices relative to cc->origin
+ * \return void
+ */
+void nurbs__evalCompiledPointsF(const nurbs_CompiledCurveF *cc,
+                                const double *us, size_t n, float *xyz);
+
+/*
+ * Evaluation kernels specialized by degree. Degrees 1, 2 and 3 get unrolled
+ * fixed-size basis computations, every other degree the generic Cox-de Boor
+ * path. Look the kernel up once from nurbs_CurveData.degree and reuse it.
+ */
+typedef struct {
+    nurbs_Point (*point)(const nurbs_CurveData *data, double u);
+    nurbs_Vector (*tangent)(const nurbs_CurveData *data, double u);
+} nurbs__EvalKernel;
+
+const nurbs__EvalKernel *nurbs__evalKernel(uint8_t degree);
+
+/* --------------------------------- Kernel --------------------------------- */
+
+/*
+ * Bulk point kernels over point arrays. One table per instruction set;
+ * nurbs__kernels() returns the widest one the running CPU supports, chosen
+ * once at load time. Every vector kernel finishes the tail with the scalar
+ * one, so results only differ by FMA rounding.
+ */
+typedef struct {
+    const char *name;
+    /* out[i] = (w[i] * pts[i], w[i]), NULL w is 1 */
+    void (*pack)(const nurbs_Point *pts, const double *w, size_t n,
+                 nurbs_HPoint *out);
+    /* out[i] = pts[i].xyz / pts[i].w, and w[i] = pts[i].w unless w is NULL */
+    void (*unpack)(const nurbs_HPoint *pts, size_t n, nurbs_Point *out,
+                   double *w);
+    /* pts[i] = m * pts[i] with m a row-major 4x4 matrix */
+    void (*transform)(nurbs_HPoint *pts, size_t n, const double *m);
+    /* grow min and max to contain pts */
+    void (*aabb)(const nurbs_Point *pts, size_t n, nurbs_Point *min,
+                 nurbs_Point *max);
+    /* out[i] = |(x[i], y[i], z[i]) - q|^2, the layout of evalCurvePoints */
+    void (*distSquared)(const double *x, const double *y, const double *z,
+                        size_t n, nurbs_Point q, double *out);
+} nurbs__Kernels;
+
+void nurbs__kernelPackScalar(const nurbs_Point *pts, const double *w, size_t n,
+                             nurbs_HPoint *out);
+void nurbs__kernelUnpackScalar(const nurbs_HPoint *pts, size_t n,
+                               nurbs_Point *out, double *w);
+void nurbs__kernelTransformScalar(nurbs_HPoint *pts, size_t n, const double *m);
+void nurbs__kernelAabbScalar(const nurbs_Point *pts, size_t n,
+                             nurbs_Point *min, nurbs_Point *max);
+void nurbs__kernelDistSquaredScalar(const double *x, const double *y,
+                                    const double *z, size_t n, nurbs_Point q,
+                                    double *out);
+
+#if defined(NURBS_KERNEL_X86)
+extern const nurbs__Kernels nurbs__kernelsSSE2;
+extern const nurbs__Kernels nurbs__kernelsAVX2;
+extern const nurbs__Kernels nurbs__kernelsAVX512;
+#endif
+
+/**
+ * \brief Returns the kernel table for the running CPU
+ *
+ * \return const nurbs__Kernels*
+ */
+const nurbs__Kernels *nurbs__kernels(void);
+
+/* ----------------------------------- Mat ---------------------------------- */
+
+void nurbs__matIdentity4(nurbs_Matrix4 *m);
+
+/**
+ * \brief r = a * b, r may alias a or b
+ */
+void nurbs__matCompose4(const nurbs_Matrix4 *a, const nurbs_Matrix4 *b,
+                        nurbs_Matrix4 *r);
+
+/**
+ * \brief Inverse of a 4x4 matrix, r may alias m
+ *
+ * \return int NURBS_FALSE if m is singular relative to its scale
+ */
+int nurbs__matInvert4(const nurbs_Matrix4 *m, nurbs_Matrix4 *r);
+
+int nurbs__matIsAffine4(const nurbs_Matrix4 *m);
+
+/**
+ * \brief Whether m is a rotation plus translation, no scale or reflection
+ */
+int nurbs__matIsRigid4(const nurbs_Matrix4 *m);
+
+/**
+ * \brief Transform a point, dividing by w for projective matrices
+ */
+nurbs_Point nurbs__matTransformPoint(const nurbs_Matrix4 *m, nurbs_Point p);
+
+/**
+ * \brief Transform a direction by the upper 3x3 part of m
+ */
+nurbs_Vector nurbs__matTransformVector(const nurbs_Matrix4 *m, nurbs_Vector v);
+
+/**
+ * \brief Transform the homogeneous control points of a curve in place
+ *
+ * One pass of the SIMD transform kernel over the packed control points;
+ * projective matrices change the weights as well.
+ *
+ * \param data The curve data
+ * \param m The transformation matrix
+ * \return void
+ */
+void nurbs__matTransformCurve(nurbs_CurveData *data, const nurbs_Matrix4 *m);
+
+/**
+ * \brief In-place LU decomposition of a band matrix, without pivoting
+ *
+ * Row i of the n x n matrix stores its columns i - ml .. i + mu at
+ * a[i * (ml + mu + 1) + j - i + ml]. Without pivoting the factors stay in
+ * the band; this is stable for totally positive matrices such as B-spline
+ * collocation matrices.
+ *
+ * \param a The band storage, overwritten by L (unit diagonal) and U
+ * \param n The order of the matrix
+ * \param ml The number of sub-diagonals
+ * \param mu The number of super-diagonals
+ * \return int NURBS_FALSE if a pivot vanishes
+ */
+int nurbs__matBandDecompose(double *a, size_t n, size_t ml, size_t mu);
+
+/**
+ * \brief Solve with the factors from nurbs__matBandDecompose
+ *
+ * \param a The decomposed band storage
+ * \param n The order of the matrix
+ * \param ml The number of sub-diagonals
+ * \param mu The number of super-diagonals
+ * \param b Row-major n x nrhs right-hand sides, overwritten by the solution
+ * \param nrhs The number of right-hand sides
+ * \return void
+ */
+void nurbs__matBandSolve(const double *a, size_t n, size_t ml, size_t mu,
+                         double *b, size_t nrhs);
+
+/**
+ * \brief In-place Cholesky decomposition of a symmetric positive definite band
+ * matrix
+ *
+ * Only the lower band is stored, row i keeps columns i - m .. i at
+ * a[i * (m + 1) + j - i + m].
+ *
+ * \param a The band storage, overwritten by the factor L with A = L L^T
+ * \param n The order of the matrix
+ * \param m The half bandwidth
+ * \return int NURBS_FALSE if the matrix is not positive definite
+ */
+int nurbs__matBandCholesky(double *a, size_t n, size_t m);
+
+/**
+ * \brief Solve with the factor from nurbs__matBandCholesky
+ *
+ * \param a The factored band storage
+ * \param n The order of the matrix
+ * \param m The half bandwidth
+ * \param b Row-major n x nrhs right-hand sides, overwritten by the solution
+ * \param nrhs The number of right-hand sides
  * \return void
  */
-void nurbs__evalHomogenize1d(nurbs_PointArray *pa, double *weights);
+void nurbs__matBandCholeskySolve(const double *a, size_t n, size_t m,
+                                 double *b, size_t nrhs);
+
+/* ---------------------------------- Store --------------------------------- */
+
+/* per curve header, the arrays live in the store pools */
+typedef struct {
+    int type;                        /* NURBS_CURVE_* of the source curve */
+    uint8_t degree;                  /* degree of curve */
+    uint32_t nknots;                 /* number of knot values */
+    uint32_t npoints;                /* number of control vertex */
+    uint32_t slot;                   /* handle slot referring to the curve */
+    size_t knots;                    /* offset into the knot pool */
+    size_t hpoints;                  /* offset into the control vertex pool */
+    struct nurbs__KnotIndex *kindex; /* span lookup table, NULL for curves
+                                        under NURBS__KINDEXMIN spans */
+} nurbs__StoreRecord;
+
+/* a handle is the slot generation in the high and the slot in the low half */
+#define NURBS__STOREHANDLE(slot, generation) \
+    ((nurbs_CurveHandle)(generation) << 32 | (slot))
+
+/* handle slot, index is the record while live, the next free slot if not */
+typedef struct {
+    uint32_t generation;
+    uint32_t index;
+} nurbs__StoreSlot;
+
+struct nurbs__CurveStore {
+    nurbs__StoreRecord *records; /* headers in memory order */
+    size_t nrecords;
+    size_t crecords;
+    double *knots; /* knot pool */
+    size_t nknots;
+    size_t cknots;
+    nurbs_HPoint *hpoints; /* control vertex pool */
+    size_t npoints;
+    size_t cpoints;
+    nurbs__StoreSlot *slots; /* handle table */
+    size_t nslots;
+    size_t cslots;
+    uint32_t freeslot; /* first free slot, UINT32_MAX if none */
+};
+
+/**
+ * \brief Create an empty curve store
+ *
+ * \param ncurves The number of curves to reserve room for
+ * \param nknots The number of knot values to reserve room for
+ * \param npoints The number of control vertex to reserve room for
+ * \return The store, NULL if out of memory
+ */
+nurbs_CurveStore *nurbs__storeNew(size_t ncurves, size_t nknots,
+                                  size_t npoints);
+
+/**
+ * \brief Release a curve store and everything in it
+ *
+ * \param store The store, may be NULL
+ * \return void
+ */
+void nurbs__storeFree(nurbs_CurveStore *store);
+
+/**
+ * \brief Grow the pools so that a number of curves fit without reallocating
+ *
+ * \param store The store
+ * \param ncurves The number of curves to add
+ * \param nknots The total number of knot values to add
+ * \param npoints The total number of control vertex to add
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__storeReserve(nurbs_CurveStore *store, size_t ncurves,
+                        size_t nknots, size_t npoints);
+
+/**
+ * \brief Append one curve header and hand out its pool arrays to fill
+ *
+ * The pools must have room, see nurbs__storeReserve. Call
+ * nurbs__storeCommit once the knots are written.
+ *
+ * \param store The store
+ * \param type The NURBS_CURVE_* type to record
+ * \param degree The degree of the curve
+ * \param nknots The number of knot values
+ * \param npoints The number of control vertex
+ * \param knots Output pointer to the knot values to write
+ * \param hpoints Output pointer to the control vertex to write
+ * \return The handle of the new curve
+ */
+nurbs_CurveHandle nurbs__storePush(nurbs_CurveStore *store, int type,
+                                   uint8_t degree, size_t nknots,
+                                   size_t npoints, double **knots,
+                                   nurbs_HPoint **hpoints);
+
+/**
+ * \brief Finish the curves pushed since a record count
+ *
+ * Builds the span lookup tables of long curves, which views refer to so
+ * evaluating through a view never allocates. On failure the curves are
+ * removed again.
+ *
+ * \param store The store
+ * \param first The record count before the pushes
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory
+ */
+int nurbs__storeCommit(nurbs_CurveStore *store, size_t first);
+
+/**
+ * \brief Remove the last curves of a store
+ *
+ * \param store The store
+ * \param nrecords The number of curves to keep
+ * \return void
+ */
+void nurbs__storeTruncate(nurbs_CurveStore *store, size_t nrecords);
+
+/**
+ * \brief Append copies of curves
+ *
+ * \param store The store
+ * \param curves The curves to copy
+ * \param n The number of curves
+ * \param handles Output array of n handles, or NULL
+ * \return NURBS_TRUE on success, NURBS_FALSE if out of memory, in which
+ * case the store is unchanged
+ */
+int nurbs__storeAppend(nurbs_CurveStore *store,
+                       const nurbs_Curve *const *curves, size_t n,
+                       nurbs_CurveHandle *handles);
+
+/**
+ * \brief Remove curves and compact the pools, keeping the order of the rest
+ *
+ * \param store The store
+ * \param handles The handles to remove, stale and repeated ones are skipped
+ * \param n The number of handles
+ * \return The number of curves removed
+ */
+size_t nurbs__storeRemove(nurbs_CurveStore *store,
+                          const nurbs_CurveHandle *handles, size_t n);
+
+/**
+ * \brief Resolve a handle to the memory order index of its curve
+ *
+ * \param store The store
+ * \param handle The handle
+ * \param index Output index
+ * \return NURBS_TRUE if the handle refers to a curve in the store
+ */
+int nurbs__storeLookup(const nurbs_CurveStore *store, nurbs_CurveHandle handle,
+                       size_t *index);
+
+/**
+ * \brief Fill a view of a stored curve
+ *
+ * \param store The store
+ * \param index The memory order index
+ * \param view Output view
+ * \return void
+ */
+void nurbs__storeView(const nurbs_CurveStore *store, size_t index,
+                      nurbs_CurveView *view);
 
 /* ---------------------------------- Array --------------------------------- */
 
 typedef void (*array_free)(void *);
 
+#define NURBS_ARRAY_GROWTH 2.0 /* default capacity growth factor */
+
 typedef struct {
     uint8_t *elts;
+    uint8_t *inl; /* caller owned inline storage, NULL if none */
+    size_t ninl;  /* capacity of the inline storage */
     size_t size;
     size_t nalloc;
     size_t nelts;
     array_free free;
+    double growth; /* capacity is multiplied by this when full */
+    int scratch;   /* elts come from the thread scratch arena */
 } nurbs_array_t;
 
 #define nurbs_array_elts(arr)  ((arr)->elts)
@@ -126,6 +1383,14 @@ typedef struct {
 
 int nurbs_array_init(nurbs_array_t *arr, array_free free, size_t size,
                      size_t nalloc);
+/* array whose storage lives in the scratch arena until the enclosing
+ * nurbs__memScratchRelease, nurbs_array_destroy only runs the destructor */
+int nurbs_array_init_scratch(nurbs_array_t *arr, array_free free, size_t size,
+                             size_t nalloc);
+/* array that starts in buf, nbuf elements typically on the caller stack, and
+ * only reaches the heap when it outgrows it; buf must outlive the array */
+void nurbs_array_init_inline(nurbs_array_t *arr, array_free free, size_t size,
+                             void *buf, size_t nbuf);
 nurbs_array_t *nurbs_array_new(array_free free, size_t size, size_t nalloc);
 void nurbs_array_destroy(nurbs_array_t *arr);
 void nurbs_array_free(nurbs_array_t *arr);
@@ -133,5 +1398,14 @@ void nurbs_array_reset(nurbs_array_t *arr);
 void *nurbs_array_push(nurbs_array_t *arr);
 void *nurbs_array_pushn(nurbs_array_t *arr, size_t n);
 void nurbs_array_pop(nurbs_array_t *arr);
+/* growth factor above 1, anything else restores NURBS_ARRAY_GROWTH */
+void nurbs_array_set_growth(nurbs_array_t *arr, double growth);
+/* make room for n elements in total, exactly, without growth rounding */
+int nurbs_array_reserve(nurbs_array_t *arr, size_t n);
+/* drop unused capacity, moving back to the inline storage when it fits */
+int nurbs_array_shrink(nurbs_array_t *arr);
+/* hand the elements over as a nurbs__memAlloc block of *n elements, without
+ * a copy when they are on the heap; the array is left empty and usable */
+void *nurbs_array_steal(nurbs_array_t *arr, size_t *n);
 
 #endif /* NURBS_INTERNAL_H */
\ No newline at end of file
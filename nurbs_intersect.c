@@ -28,13 +28,13 @@ int nurbs__intersecectRay(const nurbs_Point *a0, const nurbs_Point *a,
                           nurbs__CurveCurveIntersection *intersection)
 {
 
-    double dab = nurbs__vecDot(a, b);
-    double dab0 = nurbs__vecDot(a, b0);
-    double daa0 = nurbs__vecDot(a, a0);
-    double dbb0 = nurbs__vecDot(b, b0);
-    double dba0 = nurbs__vecDot(b, a0);
-    double daa = nurbs__vecDot(a, a);
-    double dbb = nurbs__vecDot(b, b);
+    double dab = nurbs__vecDot(*a, *b);
+    double dab0 = nurbs__vecDot(*a, *b0);
+    double daa0 = nurbs__vecDot(*a, *a0);
+    double dbb0 = nurbs__vecDot(*b, *b0);
+    double dba0 = nurbs__vecDot(*b, *a0);
+    double daa = nurbs__vecDot(*a, *a);
+    double dbb = nurbs__vecDot(*b, *b);
     double div = daa * dbb - dab * dab;
 
     if (fabs(div) < NURBS__EPSILON) {
@@ -45,10 +45,8 @@ int nurbs__intersecectRay(const nurbs_Point *a0, const nurbs_Point *a,
     double w = num / div;
     double t = (dab0 - daa0 + w * dab) / daa;
 
-    nurbs_Point *p0 = (nurbs_Point *)nurbs__vecOnRay(a0, a, t);
-    nurbs_Point *p1 = (nurbs_Point *)nurbs__vecOnRay(b0, b, w);
-    intersection->point0 = *p0;
-    intersection->point1 = *p1;
+    intersection->point0 = nurbs__vecOnRay(*a0, *a, t);
+    intersection->point1 = nurbs__vecOnRay(*b0, *b, w);
     intersection->u0 = t;
     intersection->u1 = w;
 
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+
+#if defined(NURBS_KERNEL_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* --------------------------------- Scalar --------------------------------- */
+
+/* also used for the last n % width points of the vector kernels */
+void nurbs__kernelPackScalar(const nurbs_Point *pts, const double *w, size_t n,
+                             nurbs_HPoint *out)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double wi = w ? w[i] : 1.0;
+        out[i].x = pts[i].x * wi;
+        out[i].y = pts[i].y * wi;
+        out[i].z = pts[i].z * wi;
+        out[i].w = wi;
+    }
+}
+
+void nurbs__kernelUnpackScalar(const nurbs_HPoint *pts, size_t n,
+                               nurbs_Point *out, double *w)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double wi = pts[i].w;
+        out[i].x = pts[i].x / wi;
+        out[i].y = pts[i].y / wi;
+        out[i].z = pts[i].z / wi;
+        if (w)
+            w[i] = wi;
+    }
+}
+
+void nurbs__kernelTransformScalar(nurbs_HPoint *pts, size_t n, const double *m)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double x = pts[i].x, y = pts[i].y, z = pts[i].z, w = pts[i].w;
+        pts[i].x = m[0] * x + m[1] * y + m[2] * z + m[3] * w;
+        pts[i].y = m[4] * x + m[5] * y + m[6] * z + m[7] * w;
+        pts[i].z = m[8] * x + m[9] * y + m[10] * z + m[11] * w;
+        pts[i].w = m[12] * x + m[13] * y + m[14] * z + m[15] * w;
+    }
+}
+
+void nurbs__kernelAabbScalar(const nurbs_Point *pts, size_t n,
+                             nurbs_Point *min, nurbs_Point *max)
+{
+    for (size_t i = 0; i < n; ++i) {
+        min->x = pts[i].x < min->x ? pts[i].x : min->x;
+        min->y = pts[i].y < min->y ? pts[i].y : min->y;
+        min->z = pts[i].z < min->z ? pts[i].z : min->z;
+        max->x = pts[i].x > max->x ? pts[i].x : max->x;
+        max->y = pts[i].y > max->y ? pts[i].y : max->y;
+        max->z = pts[i].z > max->z ? pts[i].z : max->z;
+    }
+}
+
+void nurbs__kernelDistSquaredScalar(const double *x, const double *y,
+                                    const double *z, size_t n, nurbs_Point q,
+                                    double *out)
+{
+    for (size_t i = 0; i < n; ++i) {
+        double dx = x[i] - q.x, dy = y[i] - q.y, dz = z[i] - q.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+/* on x86 SSE2 is the baseline, the scalar table only backs other targets */
+#if !defined(NURBS_KERNEL_X86)
+static const nurbs__Kernels nurbs__kernelsScalar = {
+    "scalar",
+    nurbs__kernelPackScalar,
+    nurbs__kernelUnpackScalar,
+    nurbs__kernelTransformScalar,
+    nurbs__kernelAabbScalar,
+    nurbs__kernelDistSquaredScalar,
+};
+#endif
+
+/* -------------------------------- Dispatch -------------------------------- */
+
+#if defined(NURBS_KERNEL_X86)
+enum { NURBS__CPU_AVX2 = 1, NURBS__CPU_AVX512 = 2 };
+
+/* the AVX2 kernels are built with -mfma, AVX2 alone does not imply FMA */
+
+static int nurbs__kernelCpuFeatures(void)
+{
+    int features = 0;
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    __cpuid(info, 1);
+    /* OSXSAVE and AVX, then ask the OS which register state it saves */
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return 0;
+    int fma = (info[2] & (1 << 12)) != 0;
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) && fma)
+        features |= NURBS__CPU_AVX2;
+    if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)))
+        features |= NURBS__CPU_AVX512;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        features |= NURBS__CPU_AVX2;
+    if (__builtin_cpu_supports("avx512f"))
+        features |= NURBS__CPU_AVX512;
+#endif
+    return features;
+}
+#endif
+
+static const nurbs__Kernels *nurbs__kernelSelect(void)
+{
+#if defined(NURBS_KERNEL_X86)
+    int features = nurbs__kernelCpuFeatures();
+    if (features & NURBS__CPU_AVX512)
+        return &nurbs__kernelsAVX512;
+    if (features & NURBS__CPU_AVX2)
+        return &nurbs__kernelsAVX2;
+    return &nurbs__kernelsSSE2;
+#else
+    return &nurbs__kernelsScalar;
+#endif
+}
+
+static const nurbs__Kernels *nurbs__kernelActive = NULL;
+
+#if defined(__GNUC__)
+/* pick the kernels when the library is loaded, not on the first call */
+__attribute__((constructor)) static void nurbs__kernelInit(void)
+{
+    nurbs__kernelActive = nurbs__kernelSelect();
+}
+#endif
+
+const nurbs__Kernels *nurbs__kernels(void)
+{
+    /* the selection is idempotent, a racing first call stores the same */
+    if (nurbs__kernelActive == NULL)
+        nurbs__kernelActive = nurbs__kernelSelect();
+    return nurbs__kernelActive;
+}
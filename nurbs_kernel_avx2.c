@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+
+#if defined(NURBS_KERNEL_X86)
+#include <immintrin.h>
+
+/*
+ * Four points per iteration. The three loads hold x0 y0 z0 x1 | y1 z1 x2 y2 |
+ * z2 x3 y3 z3; two rounds of blends and one lane swap turn them into
+ * X = x0 x1 x2 x3, Y and Z, and nurbs__avx2Store runs the same steps backward.
+ */
+static inline void nurbs__avx2Load(const nurbs_Point *p, __m256d *x,
+                                   __m256d *y, __m256d *z)
+{
+    const double *d = (const double *)p;
+    __m256d v0 = _mm256_loadu_pd(d);
+    __m256d v1 = _mm256_loadu_pd(d + 4);
+    __m256d v2 = _mm256_loadu_pd(d + 8);
+    __m256d t0 = _mm256_blend_pd(v0, v1, 0xc); /* x0 y0 x2 y2 */
+    __m256d t1 = _mm256_blend_pd(v1, v2, 0xc); /* y1 z1 y3 z3 */
+    __m256d t2 = _mm256_blend_pd(v2, v0, 0xc); /* z2 x3 z0 x1 */
+    t2 = _mm256_permute2f128_pd(t2, t2, 0x01); /* z0 x1 z2 x3 */
+    *x = _mm256_blend_pd(t0, t2, 0xa);
+    *y = _mm256_shuffle_pd(t0, t1, 0x5);
+    *z = _mm256_blend_pd(t2, t1, 0xa);
+}
+
+static inline void nurbs__avx2Store(nurbs_Point *p, __m256d x, __m256d y,
+                                    __m256d z)
+{
+    double *d = (double *)p;
+    __m256d t0 = _mm256_shuffle_pd(x, y, 0x0); /* x0 y0 x2 y2 */
+    __m256d t1 = _mm256_shuffle_pd(y, z, 0xf); /* y1 z1 y3 z3 */
+    __m256d t2 = _mm256_blend_pd(z, x, 0xa);   /* z0 x1 z2 x3 */
+    t2 = _mm256_permute2f128_pd(t2, t2, 0x01); /* z2 x3 z0 x1 */
+    _mm256_storeu_pd(d, _mm256_blend_pd(t0, t2, 0xc));
+    _mm256_storeu_pd(d + 4, _mm256_blend_pd(t1, t0, 0xc));
+    _mm256_storeu_pd(d + 8, _mm256_blend_pd(t2, t1, 0xc));
+}
+
+static inline double nurbs__avx2Min(__m256d v)
+{
+    __m128d m = _mm_min_pd(_mm256_castpd256_pd128(v),
+                           _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(m, _mm_unpackhi_pd(m, m)));
+}
+
+static inline double nurbs__avx2Max(__m256d v)
+{
+    __m128d m = _mm_max_pd(_mm256_castpd256_pd128(v),
+                           _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(m, _mm_unpackhi_pd(m, m)));
+}
+
+static void nurbs__avx2Pack(const nurbs_Point *pts, const double *w, size_t n,
+                            nurbs_HPoint *out)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x, y, z, wv = w ? _mm256_loadu_pd(w + i) : _mm256_set1_pd(1.0);
+        double *d = (double *)(out + i);
+        nurbs__avx2Load(pts + i, &x, &y, &z);
+        x = _mm256_mul_pd(x, wv);
+        y = _mm256_mul_pd(y, wv);
+        z = _mm256_mul_pd(z, wv);
+        /* 4x4 transpose of the x, y, z, w rows into four points */
+        __m256d t0 = _mm256_unpacklo_pd(x, y);  /* x0 y0 x2 y2 */
+        __m256d t1 = _mm256_unpackhi_pd(x, y);  /* x1 y1 x3 y3 */
+        __m256d t2 = _mm256_unpacklo_pd(z, wv); /* z0 w0 z2 w2 */
+        __m256d t3 = _mm256_unpackhi_pd(z, wv); /* z1 w1 z3 w3 */
+        _mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_storeu_pd(d + 4, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_storeu_pd(d + 8, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_storeu_pd(d + 12, _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+    nurbs__kernelPackScalar(pts + i, w ? w + i : NULL, n - i, out + i);
+}
+
+static void nurbs__avx2Unpack(const nurbs_HPoint *pts, size_t n,
+                              nurbs_Point *out, double *w)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const double *d = (const double *)(pts + i);
+        __m256d q0 = _mm256_loadu_pd(d), q1 = _mm256_loadu_pd(d + 4);
+        __m256d q2 = _mm256_loadu_pd(d + 8), q3 = _mm256_loadu_pd(d + 12);
+        __m256d t0 = _mm256_permute2f128_pd(q0, q2, 0x20); /* x0 y0 x2 y2 */
+        __m256d t1 = _mm256_permute2f128_pd(q1, q3, 0x20); /* x1 y1 x3 y3 */
+        __m256d t2 = _mm256_permute2f128_pd(q0, q2, 0x31); /* z0 w0 z2 w2 */
+        __m256d t3 = _mm256_permute2f128_pd(q1, q3, 0x31); /* z1 w1 z3 w3 */
+        __m256d wv = _mm256_unpackhi_pd(t2, t3);
+        nurbs__avx2Store(out + i, _mm256_div_pd(_mm256_unpacklo_pd(t0, t1), wv),
+                         _mm256_div_pd(_mm256_unpackhi_pd(t0, t1), wv),
+                         _mm256_div_pd(_mm256_unpacklo_pd(t2, t3), wv));
+        if (w)
+            _mm256_storeu_pd(w + i, wv);
+    }
+    nurbs__kernelUnpackScalar(pts + i, n - i, out + i, w ? w + i : NULL);
+}
+
+/* one homogeneous point per register, m times it column by column */
+static void nurbs__avx2Transform(nurbs_HPoint *pts, size_t n, const double *m)
+{
+    __m256d c[4];
+    size_t i = 0;
+
+    for (int j = 0; j < 4; ++j)
+        c[j] = _mm256_set_pd(m[12 + j], m[8 + j], m[4 + j], m[j]);
+
+    for (; i < n; ++i) {
+        double *d = (double *)(pts + i);
+        __m256d x = _mm256_broadcast_sd(d), y = _mm256_broadcast_sd(d + 1);
+        __m256d z = _mm256_broadcast_sd(d + 2), w = _mm256_broadcast_sd(d + 3);
+        __m256d r = _mm256_mul_pd(c[3], w);
+        r = _mm256_fmadd_pd(c[2], z, r);
+        r = _mm256_fmadd_pd(c[1], y, r);
+        r = _mm256_fmadd_pd(c[0], x, r);
+        _mm256_storeu_pd(d, r);
+    }
+}
+
+static void nurbs__avx2Aabb(const nurbs_Point *pts, size_t n,
+                            nurbs_Point *min, nurbs_Point *max)
+{
+    __m256d minx = _mm256_set1_pd(min->x), maxx = _mm256_set1_pd(max->x);
+    __m256d miny = _mm256_set1_pd(min->y), maxy = _mm256_set1_pd(max->y);
+    __m256d minz = _mm256_set1_pd(min->z), maxz = _mm256_set1_pd(max->z);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d x, y, z;
+        nurbs__avx2Load(pts + i, &x, &y, &z);
+        minx = _mm256_min_pd(minx, x);
+        miny = _mm256_min_pd(miny, y);
+        minz = _mm256_min_pd(minz, z);
+        maxx = _mm256_max_pd(maxx, x);
+        maxy = _mm256_max_pd(maxy, y);
+        maxz = _mm256_max_pd(maxz, z);
+    }
+
+    min->x = nurbs__avx2Min(minx);
+    min->y = nurbs__avx2Min(miny);
+    min->z = nurbs__avx2Min(minz);
+    max->x = nurbs__avx2Max(maxx);
+    max->y = nurbs__avx2Max(maxy);
+    max->z = nurbs__avx2Max(maxz);
+    nurbs__kernelAabbScalar(pts + i, n - i, min, max);
+}
+
+static void nurbs__avx2DistSquared(const double *x, const double *y,
+                                   const double *z, size_t n,
+                                   nurbs_Point q, double *out)
+{
+    __m256d qx = _mm256_set1_pd(q.x), qy = _mm256_set1_pd(q.y);
+    __m256d qz = _mm256_set1_pd(q.z);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), qx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), qy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), qz);
+        __m256d d = _mm256_mul_pd(dx, dx);
+        d = _mm256_fmadd_pd(dy, dy, d);
+        d = _mm256_fmadd_pd(dz, dz, d);
+        _mm256_storeu_pd(out + i, d);
+    }
+    nurbs__kernelDistSquaredScalar(x + i, y + i, z + i, n - i, q, out + i);
+}
+
+const nurbs__Kernels nurbs__kernelsAVX2 = {
+    "avx2",
+    nurbs__avx2Pack,
+    nurbs__avx2Unpack,
+    nurbs__avx2Transform,
+    nurbs__avx2Aabb,
+    nurbs__avx2DistSquared,
+};
+
+#endif /* NURBS_KERNEL_X86 */
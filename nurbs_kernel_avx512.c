@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+
+#if defined(NURBS_KERNEL_X86)
+#include <immintrin.h>
+
+/*
+ * Eight points per iteration, i.e. 24 doubles in three registers. Each
+ * coordinate is gathered with one two-source permute over the first two
+ * registers and a masked permute that fills the remaining lanes from the
+ * third; storing runs the same index tables backward.
+ */
+static inline void nurbs__avx512Load(const nurbs_Point *p, __m512d *x,
+                                     __m512d *y, __m512d *z)
+{
+    const double *d = (const double *)p;
+    __m512d v0 = _mm512_loadu_pd(d);
+    __m512d v1 = _mm512_loadu_pd(d + 8);
+    __m512d v2 = _mm512_loadu_pd(d + 16);
+    const __m512i ix0 = _mm512_set_epi64(0, 0, 15, 12, 9, 6, 3, 0);
+    const __m512i ix1 = _mm512_set_epi64(5, 2, 0, 0, 0, 0, 0, 0);
+    const __m512i iy0 = _mm512_set_epi64(0, 0, 0, 13, 10, 7, 4, 1);
+    const __m512i iy1 = _mm512_set_epi64(6, 3, 0, 0, 0, 0, 0, 0);
+    const __m512i iz0 = _mm512_set_epi64(0, 0, 0, 14, 11, 8, 5, 2);
+    const __m512i iz1 = _mm512_set_epi64(7, 4, 1, 0, 0, 0, 0, 0);
+    *x = _mm512_mask_permutexvar_pd(_mm512_permutex2var_pd(v0, ix0, v1), 0xc0,
+                                    ix1, v2);
+    *y = _mm512_mask_permutexvar_pd(_mm512_permutex2var_pd(v0, iy0, v1), 0xe0,
+                                    iy1, v2);
+    *z = _mm512_mask_permutexvar_pd(_mm512_permutex2var_pd(v0, iz0, v1), 0xe0,
+                                    iz1, v2);
+}
+
+static inline void nurbs__avx512Store(nurbs_Point *p, __m512d x, __m512d y,
+                                      __m512d z)
+{
+    double *d = (double *)p;
+    /* x and y through a two-source permute, z through a masked one */
+    const __m512i ixy0 = _mm512_set_epi64(10, 2, 0, 9, 1, 0, 8, 0);
+    const __m512i iz0 = _mm512_set_epi64(0, 0, 1, 0, 0, 0, 0, 0);
+    const __m512i ixy1 = _mm512_set_epi64(5, 0, 12, 4, 0, 11, 3, 0);
+    const __m512i iz1 = _mm512_set_epi64(0, 4, 0, 0, 3, 0, 0, 2);
+    const __m512i ixy2 = _mm512_set_epi64(0, 15, 7, 0, 14, 6, 0, 13);
+    const __m512i iz2 = _mm512_set_epi64(7, 0, 0, 6, 0, 0, 5, 0);
+    _mm512_storeu_pd(d, _mm512_mask_permutexvar_pd(
+                            _mm512_permutex2var_pd(x, ixy0, y), 0x24, iz0, z));
+    _mm512_storeu_pd(d + 8,
+                     _mm512_mask_permutexvar_pd(
+                         _mm512_permutex2var_pd(x, ixy1, y), 0x49, iz1, z));
+    _mm512_storeu_pd(d + 16,
+                     _mm512_mask_permutexvar_pd(
+                         _mm512_permutex2var_pd(x, ixy2, y), 0x92, iz2, z));
+}
+
+static void nurbs__avx512Pack(const nurbs_Point *pts, const double *w,
+                              size_t n, nurbs_HPoint *out)
+{
+    const __m512i lo = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+    const __m512i hi = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d x, y, z, wv = w ? _mm512_loadu_pd(w + i) : _mm512_set1_pd(1.0);
+        double *d = (double *)(out + i);
+        nurbs__avx512Load(pts + i, &x, &y, &z);
+        x = _mm512_mul_pd(x, wv);
+        y = _mm512_mul_pd(y, wv);
+        z = _mm512_mul_pd(z, wv);
+        __m512d t0 = _mm512_unpacklo_pd(x, y);  /* x0 y0 x2 y2 x4 y4 x6 y6 */
+        __m512d t1 = _mm512_unpackhi_pd(x, y);  /* x1 y1 x3 y3 ... */
+        __m512d t2 = _mm512_unpacklo_pd(z, wv); /* z0 w0 z2 w2 ... */
+        __m512d t3 = _mm512_unpackhi_pd(z, wv); /* z1 w1 z3 w3 ... */
+        __m512d u0 = _mm512_permutex2var_pd(t0, lo, t2); /* p0 p2 */
+        __m512d u1 = _mm512_permutex2var_pd(t1, lo, t3); /* p1 p3 */
+        __m512d u2 = _mm512_permutex2var_pd(t0, hi, t2); /* p4 p6 */
+        __m512d u3 = _mm512_permutex2var_pd(t1, hi, t3); /* p5 p7 */
+        _mm512_storeu_pd(d, _mm512_shuffle_f64x2(u0, u1, 0x44));
+        _mm512_storeu_pd(d + 8, _mm512_shuffle_f64x2(u0, u1, 0xee));
+        _mm512_storeu_pd(d + 16, _mm512_shuffle_f64x2(u2, u3, 0x44));
+        _mm512_storeu_pd(d + 24, _mm512_shuffle_f64x2(u2, u3, 0xee));
+    }
+    nurbs__kernelPackScalar(pts + i, w ? w + i : NULL, n - i, out + i);
+}
+
+static void nurbs__avx512Unpack(const nurbs_HPoint *pts, size_t n,
+                                nurbs_Point *out, double *w)
+{
+    const __m512i even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const double *d = (const double *)(pts + i);
+        __m512d o0 = _mm512_loadu_pd(d), o1 = _mm512_loadu_pd(d + 8);
+        __m512d o2 = _mm512_loadu_pd(d + 16), o3 = _mm512_loadu_pd(d + 24);
+        __m512d a = _mm512_shuffle_f64x2(o0, o1, 0x88); /* xy of p0..p3 */
+        __m512d b = _mm512_shuffle_f64x2(o0, o1, 0xdd); /* zw of p0..p3 */
+        __m512d c = _mm512_shuffle_f64x2(o2, o3, 0x88); /* xy of p4..p7 */
+        __m512d e = _mm512_shuffle_f64x2(o2, o3, 0xdd); /* zw of p4..p7 */
+        __m512d wv = _mm512_permutex2var_pd(b, odd, e);
+        nurbs__avx512Store(
+            out + i, _mm512_div_pd(_mm512_permutex2var_pd(a, even, c), wv),
+            _mm512_div_pd(_mm512_permutex2var_pd(a, odd, c), wv),
+            _mm512_div_pd(_mm512_permutex2var_pd(b, even, e), wv));
+        if (w)
+            _mm512_storeu_pd(w + i, wv);
+    }
+    nurbs__kernelUnpackScalar(pts + i, n - i, out + i, w ? w + i : NULL);
+}
+
+/* two homogeneous points per register, broadcasts stay in 256 bit halves */
+static void nurbs__avx512Transform(nurbs_HPoint *pts, size_t n,
+                                   const double *m)
+{
+    __m512d c[4];
+    size_t i = 0;
+
+    for (int j = 0; j < 4; ++j) {
+        c[j] = _mm512_broadcast_f64x4(
+            _mm256_set_pd(m[12 + j], m[8 + j], m[4 + j], m[j]));
+    }
+
+    for (; i + 2 <= n; i += 2) {
+        double *d = (double *)(pts + i);
+        __m512d h = _mm512_loadu_pd(d);
+        __m512d r = _mm512_mul_pd(c[3], _mm512_permutex_pd(h, 0xff));
+        r = _mm512_fmadd_pd(c[2], _mm512_permutex_pd(h, 0xaa), r);
+        r = _mm512_fmadd_pd(c[1], _mm512_permutex_pd(h, 0x55), r);
+        r = _mm512_fmadd_pd(c[0], _mm512_permutex_pd(h, 0x00), r);
+        _mm512_storeu_pd(d, r);
+    }
+    nurbs__kernelTransformScalar(pts + i, n - i, m);
+}
+
+static void nurbs__avx512Aabb(const nurbs_Point *pts, size_t n,
+                              nurbs_Point *min, nurbs_Point *max)
+{
+    __m512d minx = _mm512_set1_pd(min->x), maxx = _mm512_set1_pd(max->x);
+    __m512d miny = _mm512_set1_pd(min->y), maxy = _mm512_set1_pd(max->y);
+    __m512d minz = _mm512_set1_pd(min->z), maxz = _mm512_set1_pd(max->z);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d x, y, z;
+        nurbs__avx512Load(pts + i, &x, &y, &z);
+        minx = _mm512_min_pd(minx, x);
+        miny = _mm512_min_pd(miny, y);
+        minz = _mm512_min_pd(minz, z);
+        maxx = _mm512_max_pd(maxx, x);
+        maxy = _mm512_max_pd(maxy, y);
+        maxz = _mm512_max_pd(maxz, z);
+    }
+
+    min->x = _mm512_reduce_min_pd(minx);
+    min->y = _mm512_reduce_min_pd(miny);
+    min->z = _mm512_reduce_min_pd(minz);
+    max->x = _mm512_reduce_max_pd(maxx);
+    max->y = _mm512_reduce_max_pd(maxy);
+    max->z = _mm512_reduce_max_pd(maxz);
+    nurbs__kernelAabbScalar(pts + i, n - i, min, max);
+}
+
+static void nurbs__avx512DistSquared(const double *x, const double *y,
+                                     const double *z, size_t n,
+                                     nurbs_Point q, double *out)
+{
+    __m512d qx = _mm512_set1_pd(q.x), qy = _mm512_set1_pd(q.y);
+    __m512d qz = _mm512_set1_pd(q.z);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + i), qx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + i), qy);
+        __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + i), qz);
+        __m512d d = _mm512_mul_pd(dx, dx);
+        d = _mm512_fmadd_pd(dy, dy, d);
+        d = _mm512_fmadd_pd(dz, dz, d);
+        _mm512_storeu_pd(out + i, d);
+    }
+    nurbs__kernelDistSquaredScalar(x + i, y + i, z + i, n - i, q, out + i);
+}
+
+const nurbs__Kernels nurbs__kernelsAVX512 = {
+    "avx512",
+    nurbs__avx512Pack,
+    nurbs__avx512Unpack,
+    nurbs__avx512Transform,
+    nurbs__avx512Aabb,
+    nurbs__avx512DistSquared,
+};
+
+#endif /* NURBS_KERNEL_X86 */
@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+
+#if defined(NURBS_KERNEL_X86)
+#include <emmintrin.h>
+
+/*
+ * Two points per iteration. Three loads hold x0 y0 | z0 x1 | y1 z1, which
+ * nurbs__sse2Load shuffles into X = x0 x1, Y = y0 y1 and Z = z0 z1.
+ */
+static inline void nurbs__sse2Load(const nurbs_Point *p, __m128d *x,
+                                   __m128d *y, __m128d *z)
+{
+    const double *d = (const double *)p;
+    __m128d v0 = _mm_loadu_pd(d);
+    __m128d v1 = _mm_loadu_pd(d + 2);
+    __m128d v2 = _mm_loadu_pd(d + 4);
+    *x = _mm_shuffle_pd(v0, v1, 2);
+    *y = _mm_shuffle_pd(v0, v2, 1);
+    *z = _mm_shuffle_pd(v1, v2, 2);
+}
+
+static inline void nurbs__sse2Store(nurbs_Point *p, __m128d x, __m128d y,
+                                    __m128d z)
+{
+    double *d = (double *)p;
+    _mm_storeu_pd(d, _mm_shuffle_pd(x, y, 0));
+    _mm_storeu_pd(d + 2, _mm_shuffle_pd(z, x, 2));
+    _mm_storeu_pd(d + 4, _mm_shuffle_pd(y, z, 3));
+}
+
+static void nurbs__sse2Pack(const nurbs_Point *pts, const double *w, size_t n,
+                            nurbs_HPoint *out)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x, y, z, wv = w ? _mm_loadu_pd(w + i) : _mm_set1_pd(1.0);
+        double *d = (double *)(out + i);
+        nurbs__sse2Load(pts + i, &x, &y, &z);
+        x = _mm_mul_pd(x, wv);
+        y = _mm_mul_pd(y, wv);
+        z = _mm_mul_pd(z, wv);
+        _mm_storeu_pd(d, _mm_unpacklo_pd(x, y));
+        _mm_storeu_pd(d + 2, _mm_unpacklo_pd(z, wv));
+        _mm_storeu_pd(d + 4, _mm_unpackhi_pd(x, y));
+        _mm_storeu_pd(d + 6, _mm_unpackhi_pd(z, wv));
+    }
+    nurbs__kernelPackScalar(pts + i, w ? w + i : NULL, n - i, out + i);
+}
+
+static void nurbs__sse2Unpack(const nurbs_HPoint *pts, size_t n,
+                              nurbs_Point *out, double *w)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const double *d = (const double *)(pts + i);
+        __m128d a0 = _mm_loadu_pd(d), b0 = _mm_loadu_pd(d + 2);
+        __m128d a1 = _mm_loadu_pd(d + 4), b1 = _mm_loadu_pd(d + 6);
+        __m128d wv = _mm_unpackhi_pd(b0, b1);
+        nurbs__sse2Store(out + i, _mm_div_pd(_mm_unpacklo_pd(a0, a1), wv),
+                         _mm_div_pd(_mm_unpackhi_pd(a0, a1), wv),
+                         _mm_div_pd(_mm_unpacklo_pd(b0, b1), wv));
+        if (w)
+            _mm_storeu_pd(w + i, wv);
+    }
+    nurbs__kernelUnpackScalar(pts + i, n - i, out + i, w ? w + i : NULL);
+}
+
+/* one point per iteration, each register holds half of a homogeneous point */
+static void nurbs__sse2Transform(nurbs_HPoint *pts, size_t n, const double *m)
+{
+    __m128d lo[4], hi[4];
+
+    for (int j = 0; j < 4; ++j) {
+        lo[j] = _mm_set_pd(m[4 + j], m[j]);
+        hi[j] = _mm_set_pd(m[12 + j], m[8 + j]);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        double *d = (double *)(pts + i);
+        __m128d x = _mm_load1_pd(d), y = _mm_load1_pd(d + 1);
+        __m128d z = _mm_load1_pd(d + 2), w = _mm_load1_pd(d + 3);
+        __m128d rlo = _mm_add_pd(
+            _mm_add_pd(_mm_mul_pd(lo[0], x), _mm_mul_pd(lo[1], y)),
+            _mm_add_pd(_mm_mul_pd(lo[2], z), _mm_mul_pd(lo[3], w)));
+        __m128d rhi = _mm_add_pd(
+            _mm_add_pd(_mm_mul_pd(hi[0], x), _mm_mul_pd(hi[1], y)),
+            _mm_add_pd(_mm_mul_pd(hi[2], z), _mm_mul_pd(hi[3], w)));
+        _mm_storeu_pd(d, rlo);
+        _mm_storeu_pd(d + 2, rhi);
+    }
+}
+
+static void nurbs__sse2Aabb(const nurbs_Point *pts, size_t n,
+                            nurbs_Point *min, nurbs_Point *max)
+{
+    __m128d minx = _mm_set1_pd(min->x), maxx = _mm_set1_pd(max->x);
+    __m128d miny = _mm_set1_pd(min->y), maxy = _mm_set1_pd(max->y);
+    __m128d minz = _mm_set1_pd(min->z), maxz = _mm_set1_pd(max->z);
+    double lo[2], hi[2];
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d x, y, z;
+        nurbs__sse2Load(pts + i, &x, &y, &z);
+        minx = _mm_min_pd(minx, x);
+        miny = _mm_min_pd(miny, y);
+        minz = _mm_min_pd(minz, z);
+        maxx = _mm_max_pd(maxx, x);
+        maxy = _mm_max_pd(maxy, y);
+        maxz = _mm_max_pd(maxz, z);
+    }
+
+    _mm_storeu_pd(lo, minx);
+    _mm_storeu_pd(hi, maxx);
+    min->x = lo[0] < lo[1] ? lo[0] : lo[1];
+    max->x = hi[0] > hi[1] ? hi[0] : hi[1];
+    _mm_storeu_pd(lo, miny);
+    _mm_storeu_pd(hi, maxy);
+    min->y = lo[0] < lo[1] ? lo[0] : lo[1];
+    max->y = hi[0] > hi[1] ? hi[0] : hi[1];
+    _mm_storeu_pd(lo, minz);
+    _mm_storeu_pd(hi, maxz);
+    min->z = lo[0] < lo[1] ? lo[0] : lo[1];
+    max->z = hi[0] > hi[1] ? hi[0] : hi[1];
+    nurbs__kernelAabbScalar(pts + i, n - i, min, max);
+}
+
+static void nurbs__sse2DistSquared(const double *x, const double *y,
+                                   const double *z, size_t n,
+                                   nurbs_Point q, double *out)
+{
+    __m128d qx = _mm_set1_pd(q.x), qy = _mm_set1_pd(q.y);
+    __m128d qz = _mm_set1_pd(q.z);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), qx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), qy);
+        __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), qz);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx),
+                                                     _mm_mul_pd(dy, dy)),
+                                          _mm_mul_pd(dz, dz)));
+    }
+    nurbs__kernelDistSquaredScalar(x + i, y + i, z + i, n - i, q, out + i);
+}
+
+const nurbs__Kernels nurbs__kernelsSSE2 = {
+    "sse2",
+    nurbs__sse2Pack,
+    nurbs__sse2Unpack,
+    nurbs__sse2Transform,
+    nurbs__sse2Aabb,
+    nurbs__sse2DistSquared,
+};
+
+#endif /* NURBS_KERNEL_X86 */
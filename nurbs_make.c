@@ -25,169 +25,173 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 
-nurbs_CurveData *nurbs__makeEllipseArc(const nurbs_Point *center,
-                                       const nurbs_Vector *xaxis,
-                                       const nurbs_Vector *yaxis,
-                                       double minAngle, double maxAngle)
+#define NURBS__ALIGNUP(n) (((n) + NURBS__ALIGN - 1) & ~(size_t)(NURBS__ALIGN - 1))
+
+// curve | data | point array | hpoints | knots, each array starting on an
+// NURBS__ALIGN boundary
+size_t nurbs__makeSize(size_t size, size_t np, size_t nknots)
 {
-    double xradius = nurbs__vecNorm((const double *)xaxis);
-    double yradius = nurbs__vecNorm((const double *)yaxis);
+    size_t opoints = NURBS__ALIGNUP(NURBS__ALIGNUP(size) +
+                                    sizeof(nurbs_CurveData) +
+                                    sizeof(nurbs_PointArray));
+    size_t oknots = NURBS__ALIGNUP(opoints + sizeof(nurbs_HPoint) * np);
+    return NURBS__ALIGNUP(oknots + sizeof(double) * nknots);
+}
 
-    nurbs_Vector *lxaxis = (nurbs_Vector *)nurbs__vecNormalized(xaxis);
-    nurbs_Vector *lyaxis = (nurbs_Vector *)nurbs__vecNormalized(yaxis);
+nurbs_Curve *nurbs__makeLayout(void *mem, size_t size, uint8_t degree,
+                               size_t np, size_t nknots)
+{
+    assert(size >= sizeof(nurbs_Curve));
+    assert(((uintptr_t)mem & (NURBS__ALIGN - 1)) == 0);
+    size_t odata = NURBS__ALIGNUP(size);
+    size_t oparr = odata + sizeof(nurbs_CurveData);
+    size_t opoints = NURBS__ALIGNUP(oparr + sizeof(nurbs_PointArray));
+    size_t oknots = NURBS__ALIGNUP(opoints + sizeof(nurbs_HPoint) * np);
+
+    uint8_t *block = (uint8_t *)mem;
+    nurbs_Curve *curve = (nurbs_Curve *)block;
+    nurbs_CurveData *data = (nurbs_CurveData *)(block + odata);
+    nurbs_PointArray *parr = (nurbs_PointArray *)(block + oparr);
+    memset(block, 0, oparr);
+    parr->npoints = np;
+    parr->hpoints = (nurbs_HPoint *)(block + opoints);
+    data->degree = degree;
+    data->nknots = (uint32_t)nknots;
+    data->knots = (double *)(block + oknots);
+    data->cv = parr;
+    data->kindex = NULL;
+    curve->type = NURBS_CURVE_NURBS;
+    curve->nurbs_data = data;
+    return curve;
+}
+
+nurbs_Curve *nurbs__makeAlloc(size_t size, uint8_t degree, size_t np,
+                              size_t nknots)
+{
+    void *block = nurbs__memAlloc(nurbs__makeSize(size, np, nknots));
+    if (block == NULL)
+        return NULL;
+    return nurbs__makeLayout(block, size, degree, np, nknots);
+}
 
+void nurbs__makeFree(nurbs_Curve *curve)
+{
+    if (curve == NULL)
+        return;
+    nurbs__memFree(curve->nurbs_data->kindex);
+    nurbs__memFree(curve);
+}
+
+size_t nurbs__makeEllipseArcSegments(double minAngle, double *maxAngle)
+{
     // if the end angle is less than the start angle, do a circle.
-    if (maxAngle < minAngle)
-        maxAngle = 2.0 * M_PI + minAngle;
+    if (*maxAngle < minAngle)
+        *maxAngle = 2.0 * M_PI + minAngle;
 
-    double theta = maxAngle - minAngle;
-    size_t numArcs = 0;
+    double theta = *maxAngle - minAngle;
     // how many arcs?
     if (theta < M_PI_2)
-        numArcs = 1;
-    else {
-        if (theta <= M_PI)
-            numArcs = 2;
-        else if (theta <= 3.0 * M_PI_2)
-            numArcs = 3;
-        else
-            numArcs = 4;
-    }
+        return 1;
+    else if (theta <= M_PI)
+        return 2;
+    else if (theta <= 3.0 * M_PI_2)
+        return 3;
+    return 4;
+}
 
-    double dtheta = theta / numArcs;
+void nurbs__makeEllipseArcFill(const nurbs_Point *center,
+                               const nurbs_Vector *xaxis,
+                               const nurbs_Vector *yaxis, double minAngle,
+                               double maxAngle, size_t numArcs, double *knots,
+                               nurbs_HPoint *hpoints)
+{
+    // control point k sits at angle minAngle + k * h. The middle point of a
+    // segment is where the end tangents meet, the affine image of the circle
+    // case center + (cos, sin) / cos(h), and has weight cos(h), so its
+    // homogeneous form is center * cos(h) + xaxis * cos + yaxis * sin.
     size_t n = 2 * numArcs;
-    double w1 = cos(dtheta / 2);
-    nurbs_Point *P0 = (nurbs_Point *)nurbs__vecAdd(
-        center, nurbs__vecAdd(nurbs__vecMul(lxaxis, xradius * cos(minAngle)),
-                              nurbs__vecMul(lyaxis, yradius * sin(minAngle))));
-    nurbs_Vector *T0 =
-        (nurbs_Vector *)nurbs__vecSub(nurbs__vecMul(lyaxis, cos(minAngle)),
-                                      nurbs__vecMul(lxaxis, sin(minAngle)));
-    double *knots = (double *)calloc(2 * numArcs + 3, sizeof(double));
-    assert(knots);
-    size_t index = 0;
-    double angle = minAngle;
-    double *weights = (double *)calloc(numArcs * 2 + 1, sizeof(double));
-    assert(weights);
-    nurbs_PointArray *parr =
-        (nurbs_PointArray *)malloc(sizeof(nurbs_PointArray));
-    assert(parr);
-    parr->npoints = numArcs * 2 + 1;
-    parr->points =
-        (nurbs_Point *)malloc(sizeof(nurbs_Point) * (numArcs * 2 + 1));
-    parr->weights = NULL;
-    assert(parr->points);
-    parr->npoints = numArcs * 2 + 1;
-    parr->points[0] = *P0;
-    weights[0] = 1.0;
-
-    for (size_t i = 1; i < numArcs + 1; i++) {
-        angle += dtheta;
-        nurbs_Point *P2 = (nurbs_Point *)nurbs__vecAdd(
-            center, nurbs__vecAdd(nurbs__vecMul(lxaxis, xradius * cos(angle)),
-                                  nurbs__vecMul(lyaxis, yradius * sin(angle))));
-        weights[index + 2] = 1;
-        parr->points[index + 2] = *P2;
-
-        nurbs_Vector *T2 =
-            (nurbs_Vector *)nurbs__vecSub(nurbs__vecMul(lyaxis, cos(angle)),
-                                          nurbs__vecMul(lxaxis, sin(angle)));
-        nurbs__CurveCurveIntersection inters;
-        nurbs__intersecectRay(
-            P0,
-            (const nurbs_Point *)(nurbs__vecMul(T0, 1 / nurbs__vecNorm(T0))),
-            P2,
-            (const nurbs_Point *)(nurbs__vecMul(T2, 1 / nurbs__vecNorm(T2))),
-            &inters);
-
-        nurbs_Point *T1 =
-            (nurbs_Point *)nurbs__vecAdd(P0, nurbs__vecMul(T0, inters.u0));
-
-        weights[index + 1] = w1;
-        parr->points[index + 1] = *T1;
-
-        index += 2;
-        if (i < numArcs) {
-            P0 = P2;
-            T0 = T2;
+    double h = (maxAngle - minAngle) / (double)n;
+    double ch = cos(h), sh = sin(h);
+    double c = cos(minAngle), s = sin(minAngle);
+
+    for (size_t k = 0; k <= n; ++k) {
+        if (k == n) {
+            // exact end point, not the accumulated rotation
+            c = cos(maxAngle);
+            s = sin(maxAngle);
         }
-    }
+        double w = (k & 1) ? ch : 1.0;
+        hpoints[k].x = center->x * w + xaxis->x * c + yaxis->x * s;
+        hpoints[k].y = center->y * w + xaxis->y * c + yaxis->y * s;
+        hpoints[k].z = center->z * w + xaxis->z * c + yaxis->z * s;
+        hpoints[k].w = w;
 
-    size_t j = 2 * numArcs + 1;
+        double cn = c * ch - s * sh;
+        s = s * ch + c * sh;
+        c = cn;
+    }
 
     for (size_t i = 0; i < 3; ++i) {
-        knots[i] = 0;
-        knots[i + j] = 1.0;
-    }
-
-    switch (numArcs) {
-    case 2:
-        knots[3] = knots[4] = 0.5;
-        break;
-    case 3:
-        knots[3] = knots[4] = 1.0 / 3.0;
-        knots[5] = knots[6] = 2.0 / 3.0;
-        break;
-    case 4:
-        knots[3] = knots[4] = 0.25;
-        knots[5] = knots[6] = 0.5;
-        knots[7] = knots[8] = 0.75;
-        break;
-    default:
-        break;
-    }
-
-    nurbs_CurveData *curve_data =
-        (nurbs_CurveData *)malloc(sizeof(nurbs_CurveData));
-    curve_data->degree = 2;
-    curve_data->knots = knots;
-    nurbs__evalHomogenize1d(parr, weights);
-    curve_data->cv = parr;
-    return curve_data;
-}
-
-nurbs_CurveData *nurbs__makeArc(const nurbs_Point *center,
-                                const nurbs_Vector *xaxis,
-                                const nurbs_Vector *yaxis, double radius,
-                                double minAngle, double maxAngle)
-{
-    return nurbs__makeEllipseArc(center,
-                                 (const nurbs_Vector *)nurbs__vecMul(
-                                     nurbs__vecNormalized(xaxis), radius),
-                                 (const nurbs_Vector *)nurbs__vecMul(
-                                     nurbs__vecNormalized(yaxis), radius),
-                                 minAngle, maxAngle);
-}
-
-nurbs_CurveData *nurbs__makePolyline(const nurbs_Point *points, size_t np)
+        knots[i] = 0.0;
+        knots[i + n + 1] = 1.0;
+    }
+    for (size_t i = 1; i < numArcs; ++i)
+        knots[2 * i + 1] = knots[2 * i + 2] = (double)i / (double)numArcs;
+}
+
+nurbs_Curve *nurbs__makeEllipseArc(size_t size, const nurbs_Point *center,
+                                   const nurbs_Vector *xaxis,
+                                   const nurbs_Vector *yaxis, double minAngle,
+                                   double maxAngle)
+{
+    size_t numArcs = nurbs__makeEllipseArcSegments(minAngle, &maxAngle);
+    nurbs_Curve *curve =
+        nurbs__makeAlloc(size, 2, 2 * numArcs + 1, 2 * numArcs + 4);
+    if (curve == NULL)
+        return NULL;
+
+    nurbs_CurveData *data = curve->nurbs_data;
+    nurbs__makeEllipseArcFill(center, xaxis, yaxis, minAngle, maxAngle,
+                              numArcs, data->knots, data->cv->hpoints);
+    return curve;
+}
+
+nurbs_Curve *nurbs__makeArc(size_t size, const nurbs_Point *center,
+                            const nurbs_Vector *xaxis,
+                            const nurbs_Vector *yaxis, double radius,
+                            double minAngle, double maxAngle)
+{
+    nurbs_Vector rxaxis = nurbs__vecMul(nurbs__vecNormalized(*xaxis), radius);
+    nurbs_Vector ryaxis = nurbs__vecMul(nurbs__vecNormalized(*yaxis), radius);
+    return nurbs__makeEllipseArc(size, center, &rxaxis, &ryaxis, minAngle,
+                                 maxAngle);
+}
+
+nurbs_Curve *nurbs__makePolyline(size_t size, const nurbs_Point *points,
+                                 size_t np)
 {
     // 2
     // 0,1,2,3 -- 4 element
     // 3
     // 0,1,2,3,4 -- 5 element
     assert(points && np > 1);
-    double *knots = (double *)malloc(sizeof(double) * (np + 2));
+    nurbs_Curve *curve = nurbs__makeAlloc(size, 1, np, np + 2);
+    if (curve == NULL)
+        return NULL;
+    double *knots = curve->nurbs_data->knots;
     // 0.0 0.0 ... np - 1, np
     //  0   1  ...  np+1 , np+2
-    assert(knots);
 
     double lsum = 0.0;
     knots[0] = 0.0;
     knots[1] = 0.0;
 
-    nurbs_PointArray *parr =
-        (nurbs_PointArray *)malloc(sizeof(nurbs_PointArray));
-    assert(parr);
-    parr->points = (nurbs_Point *)malloc(sizeof(nurbs_Point) * np);
-    parr->npoints = np;
-
     for (int i = 0; i < np - 1; ++i) {
-        lsum += nurbs__dist(&points[i], &points[i + 1]);
-        parr->points[i] = points[i];
+        lsum += nurbs__dist(points[i], points[i + 1]);
         knots[i + 2] = lsum;
     }
-    parr->points[np - 1] = points[np - 1];
 
     knots[np + 1] = lsum;
 
@@ -195,24 +199,512 @@ nurbs_CurveData *nurbs__makePolyline(const nurbs_Point *points, size_t np)
         knots[i] /= lsum;
     }
 
-    double *weights = (double *)malloc(sizeof(double) * np);
-    assert(weights);
+    nurbs__evalHomogenize1d(curve->nurbs_data->cv, points, NULL);
+    return curve;
+}
 
-    for (int i = 0; i < np; ++i) {
-        weights[i] = 1.0;
+nurbs_Curve *nurbs__makeKCW(uint8_t degree, const nurbs_Point *cv, size_t ncv,
+                           const double *knots, size_t nknots,
+                           const double *weights)
+{
+    assert(cv && knots);
+    if (degree < 1 || degree > NURBS__MAXDEGREE || ncv <= degree ||
+        nknots != ncv + degree + 1)
+        return NULL;
+    for (size_t i = 1; i < nknots; ++i) {
+        if (knots[i] < knots[i - 1])
+            return NULL;
+    }
+    if (!(knots[ncv] > knots[degree]))
+        return NULL;
+    if (weights != NULL) {
+        for (size_t i = 0; i < ncv; ++i) {
+            if (!(weights[i] > 0.0))
+                return NULL;
+        }
     }
 
-    nurbs_CurveData *curve_data =
-        (nurbs_CurveData *)malloc(sizeof(nurbs_CurveData));
-    curve_data->degree = 1;
-    curve_data->knots = knots;
-    nurbs__evalHomogenize1d(parr, weights);
-    curve_data->cv = parr;
-    return curve_data;
+    nurbs_Curve *curve =
+        nurbs__makeAlloc(sizeof(nurbs_Curve), degree, ncv, nknots);
+    if (curve == NULL)
+        return NULL;
+    memcpy(curve->nurbs_data->knots, knots, sizeof(double) * nknots);
+    nurbs__evalHomogenize1d(curve->nurbs_data->cv, cv, weights);
+    return curve;
+}
+
+nurbs_Curve *nurbs__makeRationalBezier(size_t size, const nurbs_Point *points,
+                                       size_t np, double *weights, size_t nw)
+{
+    return NULL;
 }
 
-nurbs_CurveData *nurbs__makeRationalBezier(const nurbs_Point *points, size_t np,
-                                           double *weights, size_t nw)
+nurbs_Curve *nurbs__makeCopy(const nurbs_CurveData *data)
 {
+    assert(data && data->cv);
+    size_t np = data->cv->npoints;
+
+    nurbs_Curve *curve = nurbs__makeAlloc(sizeof(nurbs_Curve), data->degree,
+                                          np, data->nknots);
+    if (curve == NULL)
+        return NULL;
+
+    nurbs_CurveData *copy = curve->nurbs_data;
+    memcpy(copy->knots, data->knots, sizeof(double) * data->nknots);
+    memcpy(copy->cv->hpoints, data->cv->hpoints, sizeof(nurbs_HPoint) * np);
+    return curve;
+}
+
+nurbs_Curve *nurbs__makeInterpolated(const nurbs_Point *points, size_t np,
+                                     uint8_t degree)
+{
+    assert(points);
+    if (degree < 1 || degree > NURBS__MAXDEGREE || np <= degree)
+        return NULL;
+
+    size_t p = degree;
+    size_t nknots = np + p + 1;
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    nurbs_Curve *curve =
+        nurbs__makeAlloc(sizeof(nurbs_Curve), degree, np, nknots);
+    double *ub = (double *)nurbs__memScratchAlloc(sizeof(double) * np);
+    size_t *spans = (size_t *)nurbs__memScratchAlloc(sizeof(size_t) * np);
+    nurbs_Point *cvs =
+        (nurbs_Point *)nurbs__memScratchAlloc(sizeof(nurbs_Point) * np);
+    double *band = NULL;
+    if (curve == NULL || ub == NULL || spans == NULL || cvs == NULL)
+        goto fail;
+    double *knots = curve->nurbs_data->knots;
+
+    // chord length parameters
+    double lsum = 0.0;
+    ub[0] = 0.0;
+    for (size_t i = 1; i < np; ++i) {
+        lsum += nurbs__dist(points[i - 1], points[i]);
+        ub[i] = lsum;
+    }
+    if (lsum <= NURBS__EPSILON)
+        goto fail;
+    for (size_t i = 1; i < np - 1; ++i)
+        ub[i] /= lsum;
+    ub[np - 1] = 1.0;
+
+    // knots by averaging p consecutive parameters, kept as a running sum
+    for (size_t i = 0; i <= p; ++i) {
+        knots[i] = 0.0;
+        knots[nknots - 1 - i] = 1.0;
+    }
+    double wsum = 0.0;
+    for (size_t i = 1; i <= p; ++i)
+        wsum += ub[i];
+    for (size_t j = 1; j < np - p; ++j) {
+        knots[j + p] = wsum / p;
+        wsum += ub[j + p] - ub[j];
+    }
+
+    // the band of row k is spans[k] - p .. spans[k], so collect its width
+    size_t ml = 0, mu = 0, span = p;
+    for (size_t k = 0; k < np; ++k) {
+        span = nurbs__evalKnotSpanFrom(degree, knots, (uint32_t)nknots, ub[k],
+                                       span);
+        spans[k] = span;
+        if (k + p > span && k + p - span > ml)
+            ml = k + p - span;
+        if (span > k && span - k > mu)
+            mu = span - k;
+    }
+
+    size_t w = ml + mu + 1;
+    band = (double *)nurbs__memScratchAlloc(sizeof(double) * np * w);
+    if (band == NULL)
+        goto fail;
+    memset(band, 0, sizeof(double) * np * w);
+
+    double N[NURBS__MAXDEGREE + 1];
+    for (size_t k = 0; k < np; ++k) {
+        nurbs__evalBasisFunctions(spans[k], ub[k], degree, knots, N);
+        for (size_t i = 0; i <= p; ++i)
+            band[k * w + spans[k] - p + i - k + ml] = N[i];
+    }
+
+    if (!nurbs__matBandDecompose(band, np, ml, mu))
+        goto fail;
+    memcpy(cvs, points, sizeof(nurbs_Point) * np);
+    nurbs__matBandSolve(band, np, ml, mu, (double *)cvs, 3);
+    nurbs__evalHomogenize1d(curve->nurbs_data->cv, cvs, NULL);
+
+    nurbs__memScratchRelease(mark);
+    return curve;
+
+fail:
+    nurbs__memFree(curve);
+    nurbs__memScratchRelease(mark);
     return NULL;
 }
+
+nurbs_CurveFitter *nurbs__makeFitterNew(uint8_t degree, uint32_t ncv,
+                                        double umin, double umax)
+{
+    if (degree < 1 || degree > NURBS__MAXDEGREE || ncv <= degree ||
+        !(umax > umin))
+        return NULL;
+
+    nurbs_CurveFitter *fitter =
+        (nurbs_CurveFitter *)nurbs__memAlloc(sizeof(nurbs_CurveFitter));
+    if (fitter == NULL)
+        return NULL;
+
+    size_t p = degree;
+    fitter->degree = degree;
+    fitter->ncv = ncv;
+    fitter->nknots = ncv + degree + 1;
+    fitter->knots = (double *)nurbs__memAlloc(sizeof(double) * fitter->nknots);
+    fitter->ata = (double *)nurbs__memCalloc((size_t)ncv * (p + 1), sizeof(double));
+    fitter->atb = (double *)nurbs__memCalloc((size_t)ncv * 3, sizeof(double));
+    fitter->qq = 0.0;
+    fitter->nsamples = 0;
+    fitter->origin = nurbs__vec(0.0, 0.0, 0.0);
+    fitter->span = p;
+    if (fitter->knots == NULL || fitter->ata == NULL || fitter->atb == NULL) {
+        nurbs__makeFitterFree(fitter);
+        return NULL;
+    }
+
+    for (size_t i = 0; i <= p; ++i) {
+        fitter->knots[i] = umin;
+        fitter->knots[fitter->nknots - 1 - i] = umax;
+    }
+    size_t nseg = ncv - p;
+    for (size_t j = 1; j < nseg; ++j)
+        fitter->knots[p + j] = umin + (umax - umin) * j / nseg;
+    return fitter;
+}
+
+void nurbs__makeFitterAdd(nurbs_CurveFitter *fitter, const nurbs_Point *points,
+                          const double *us, size_t n)
+{
+    assert(fitter && (n == 0 || (points && us)));
+    size_t p = fitter->degree, w = p + 1;
+    double umin = fitter->knots[0];
+    double umax = fitter->knots[fitter->nknots - 1];
+    double N[NURBS__MAXDEGREE + 1];
+
+    if (fitter->nsamples == 0 && n > 0)
+        fitter->origin = points[0];
+
+    for (size_t k = 0; k < n; ++k) {
+        double u = us[k] < umin ? umin : (us[k] > umax ? umax : us[k]);
+        size_t span = nurbs__evalKnotSpanFrom(fitter->degree, fitter->knots,
+                                              fitter->nknots, u, fitter->span);
+        nurbs__evalBasisFunctions(span, u, fitter->degree, fitter->knots, N);
+        fitter->span = span;
+
+        nurbs_Vector q = nurbs__vecSub(points[k], fitter->origin);
+        fitter->qq += nurbs__vecDot(q, q);
+
+        size_t first = span - p;
+        for (size_t a = 0; a <= p; ++a) {
+            size_t row = first + a;
+            double *arow = fitter->ata + row * w + p - row;
+            fitter->atb[row * 3] += N[a] * q.x;
+            fitter->atb[row * 3 + 1] += N[a] * q.y;
+            fitter->atb[row * 3 + 2] += N[a] * q.z;
+            for (size_t b = 0; b <= a; ++b)
+                arow[first + b] += N[a] * N[b];
+        }
+    }
+    fitter->nsamples += n;
+}
+
+/*
+ * Least squares control points of n shifted samples from the lower band of A,
+ * B and the sums, with their root mean square residual if rms is not NULL.
+ * NURBS_FALSE if the system is singular.
+ */
+static int nurbs__makeFitterLeastSquares(size_t p, size_t n, const double *ata,
+                                         const double *atb, double qq,
+                                         size_t nsamples, double *band,
+                                         nurbs_Point *cvs, double *rms)
+{
+    size_t w = p + 1;
+
+    // first difference penalty, only noticeable where samples are missing
+    double lambda = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ata[i * w + p] > lambda)
+            lambda = ata[i * w + p];
+    }
+    lambda *= NURBS__EPSILON;
+    memcpy(band, ata, sizeof(double) * n * w);
+    for (size_t i = 0; i + 1 < n; ++i) {
+        band[i * w + p] += lambda;
+        band[(i + 1) * w + p] += lambda;
+        band[(i + 1) * w + p - 1] -= lambda;
+    }
+
+    if (!nurbs__matBandCholesky(band, n, p))
+        return NURBS_FALSE;
+    memcpy(cvs, atb, sizeof(nurbs_Point) * n);
+    nurbs__matBandCholeskySolve(band, n, p, (double *)cvs, 3);
+
+    if (rms != NULL) {
+        // sum |q - C(u)|^2 = qq - 2 P.B + P^T A P
+        double e = qq;
+        const nurbs_Point *b = (const nurbs_Point *)atb;
+        for (size_t i = 0; i < n; ++i) {
+            const double *arow = ata + i * w + p - i;
+            e -= 2.0 * nurbs__vecDot(cvs[i], b[i]);
+            e += arow[i] * nurbs__vecDot(cvs[i], cvs[i]);
+            for (size_t j = i > p ? i - p : 0; j < i; ++j)
+                e += 2.0 * arow[j] * nurbs__vecDot(cvs[i], cvs[j]);
+        }
+        *rms = sqrt((e > 0.0 ? e : 0.0) / nsamples);
+    }
+    return NURBS_TRUE;
+}
+
+/* curve of n shifted control points over the given knots */
+static nurbs_Curve *nurbs__makeFitterCurve(const nurbs_CurveFitter *fitter,
+                                           size_t n, const double *knots,
+                                           nurbs_Point *cvs)
+{
+    size_t nknots = n + fitter->degree + 1;
+    nurbs_Curve *curve =
+        nurbs__makeAlloc(sizeof(nurbs_Curve), fitter->degree, n, nknots);
+    if (curve == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < n; ++i)
+        cvs[i] = nurbs__vecAdd(cvs[i], fitter->origin);
+    nurbs__evalHomogenize1d(curve->nurbs_data->cv, cvs, NULL);
+    memcpy(curve->nurbs_data->knots, knots, sizeof(double) * nknots);
+    return curve;
+}
+
+nurbs_Curve *nurbs__makeFitterSolve(const nurbs_CurveFitter *fitter,
+                                    double *rms)
+{
+    assert(fitter);
+    if (fitter->nsamples == 0)
+        return NULL;
+
+    size_t p = fitter->degree, w = p + 1, n = fitter->ncv;
+    nurbs_Curve *curve = NULL;
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    double *band = (double *)nurbs__memScratchAlloc(sizeof(double) * n * w);
+    nurbs_Point *cvs =
+        (nurbs_Point *)nurbs__memScratchAlloc(sizeof(nurbs_Point) * n);
+    if (band != NULL && cvs != NULL &&
+        nurbs__makeFitterLeastSquares(p, n, fitter->ata, fitter->atb,
+                                      fitter->qq, fitter->nsamples, band, cvs,
+                                      rms))
+        curve = nurbs__makeFitterCurve(fitter, n, fitter->knots, cvs);
+    nurbs__memScratchRelease(mark);
+    return curve;
+}
+
+/*
+ * Normal equations of the fit with m of the fitter's nseg uniform segments, m
+ * dividing nseg. The coarse knots are every r = nseg / m th knot, so the
+ * coarse B-splines are combinations of the fine ones, N_c = T^T N, and the
+ * sums follow without the samples, A_c = T^T A T and B_c = T^T B. Row i of T
+ * holds the coarse B-splines at the blossom (t[i + 1], ..., t[i + p]) of the
+ * fine knots (Oslo algorithm), nonzero in columns mu - p to mu where mu is the
+ * coarse span of t[i].
+ */
+static void nurbs__makeFitterCoarsen(const nurbs_CurveFitter *fitter,
+                                     size_t m, double *knots, double *t,
+                                     double *ata, double *atb)
+{
+    const double *U = fitter->knots;
+    size_t p = fitter->degree, w = p + 1, nf = fitter->ncv;
+    size_t r = (nf - p) / m, nc = m + p;
+    double left[NURBS__MAXDEGREE + 1], right[NURBS__MAXDEGREE + 1];
+
+    for (size_t i = 0; i <= p; ++i) {
+        knots[i] = U[i];
+        knots[nc + i] = U[nf + i];
+    }
+    for (size_t j = 1; j < m; ++j)
+        knots[p + j] = U[p + j * r];
+
+#define NURBS__COARSEMU(i) ((i) < p ? p : p + ((i) - p) / r)
+    for (size_t i = 0; i < nf; ++i) {
+        size_t mu = NURBS__COARSEMU(i);
+        double *b = t + i * w;
+        b[0] = 1.0;
+        for (size_t j = 1; j <= p; ++j) {
+            double x = U[i + j];
+            for (size_t s = 1; s <= j; ++s) {
+                left[s] = x - knots[mu + 1 - s];
+                right[s] = knots[mu + s] - x;
+            }
+            double saved = 0.0;
+            for (size_t k = 0; k < j; ++k) {
+                double temp = b[k] / (right[k + 1] + left[j - k]);
+                b[k] = saved + right[k + 1] * temp;
+                saved = left[j - k] * temp;
+            }
+            b[j] = saved;
+        }
+    }
+
+    memset(ata, 0, sizeof(double) * nc * w);
+    memset(atb, 0, sizeof(double) * nc * 3);
+    for (size_t i = 0; i < nf; ++i) {
+        size_t ci = NURBS__COARSEMU(i) - p;
+        const double *ti = t + i * w;
+        const double *arow = fitter->ata + i * w + p - i;
+        for (size_t a = 0; a <= p; ++a) {
+            for (size_t d = 0; d < 3; ++d)
+                atb[(ci + a) * 3 + d] += ti[a] * fitter->atb[i * 3 + d];
+        }
+
+        // A(i, k) for k <= i, and A(k, i) by symmetry when k < i
+        for (size_t k = i > p ? i - p : 0; k <= i; ++k) {
+            size_t ck = NURBS__COARSEMU(k) - p;
+            const double *tk = t + k * w;
+            if (arow[k] == 0.0)
+                continue;
+            for (size_t a = 0; a <= p; ++a) {
+                for (size_t b = 0; b <= p; ++b) {
+                    size_t ca = ci + a, cb = ck + b;
+                    double v = ti[a] * tk[b] * arow[k];
+                    if (ca >= cb && ca - cb <= p)
+                        ata[ca * w + p - (ca - cb)] += v;
+                    if (k < i && cb >= ca && cb - ca <= p)
+                        ata[cb * w + p - (cb - ca)] += v;
+                }
+            }
+        }
+    }
+#undef NURBS__COARSEMU
+}
+
+nurbs_Curve *nurbs__makeFitterSolveTol(const nurbs_CurveFitter *fitter,
+                                       double tol, double *rms)
+{
+    assert(fitter);
+    if (fitter->nsamples == 0 || !(tol > 0.0))
+        return NULL;
+
+    size_t p = fitter->degree, w = p + 1, nf = fitter->ncv, nseg = nf - p;
+    nurbs_Curve *curve = NULL;
+    nurbs__MemMark mark = nurbs__memScratchMark();
+    double *knots =
+        (double *)nurbs__memScratchAlloc(sizeof(double) * fitter->nknots);
+    double *t = (double *)nurbs__memScratchAlloc(sizeof(double) * nf * w);
+    double *ata = (double *)nurbs__memScratchAlloc(sizeof(double) * nf * w);
+    double *atb = (double *)nurbs__memScratchAlloc(sizeof(double) * nf * 3);
+    double *band = (double *)nurbs__memScratchAlloc(sizeof(double) * nf * w);
+    nurbs_Point *cvs =
+        (nurbs_Point *)nurbs__memScratchAlloc(sizeof(nurbs_Point) * nf);
+    if (knots == NULL || t == NULL || ata == NULL || atb == NULL ||
+        band == NULL || cvs == NULL)
+        goto done;
+
+    // fewest segments first, the full fit is the last resort
+    for (size_t m = 1; m < nseg; ++m) {
+        double e;
+        if (nseg % m != 0)
+            continue;
+        nurbs__makeFitterCoarsen(fitter, m, knots, t, ata, atb);
+        if (!nurbs__makeFitterLeastSquares(p, m + p, ata, atb, fitter->qq,
+                                           fitter->nsamples, band, cvs, &e))
+            continue;
+        if (e <= tol) {
+            if (rms != NULL)
+                *rms = e;
+            curve = nurbs__makeFitterCurve(fitter, m + p, knots, cvs);
+            goto done;
+        }
+    }
+    if (nurbs__makeFitterLeastSquares(p, nf, fitter->ata, fitter->atb,
+                                      fitter->qq, fitter->nsamples, band, cvs,
+                                      rms))
+        curve = nurbs__makeFitterCurve(fitter, nf, fitter->knots, cvs);
+
+done:
+    nurbs__memScratchRelease(mark);
+    return curve;
+}
+
+void nurbs__makeFitterFree(nurbs_CurveFitter *fitter)
+{
+    if (fitter == NULL)
+        return;
+    nurbs__memFree(fitter->knots);
+    nurbs__memFree(fitter->ata);
+    nurbs__memFree(fitter->atb);
+    nurbs__memFree(fitter);
+}
+
+int nurbs__makeStoreEllipseArcs(nurbs_CurveStore *store, int type,
+                                const nurbs_Point *centers,
+                                const nurbs_Vector *xaxes,
+                                const nurbs_Vector *yaxes, const double *radii,
+                                const double *minAngles,
+                                const double *maxAngles, size_t n,
+                                nurbs_CurveHandle *handles)
+{
+    assert(centers && xaxes && yaxes);
+    assert((minAngles == NULL) == (maxAngles == NULL));
+
+    // size the pools first, the segment count only needs the angles
+    size_t npoints = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double maxAngle = maxAngles ? maxAngles[i] : 2.0 * M_PI;
+        double minAngle = minAngles ? minAngles[i] : 0.0;
+        npoints += 2 * nurbs__makeEllipseArcSegments(minAngle, &maxAngle) + 1;
+    }
+    if (!nurbs__storeReserve(store, n, npoints + 3 * n, npoints))
+        return NURBS_FALSE;
+
+    size_t first = nurbs_store_count(store);
+    for (size_t i = 0; i < n; ++i) {
+        double maxAngle = maxAngles ? maxAngles[i] : 2.0 * M_PI;
+        double minAngle = minAngles ? minAngles[i] : 0.0;
+        size_t numArcs = nurbs__makeEllipseArcSegments(minAngle, &maxAngle);
+
+        nurbs_Vector xaxis = xaxes[i], yaxis = yaxes[i];
+        if (radii != NULL) {
+            xaxis = nurbs__vecMul(nurbs__vecNormalized(xaxis), radii[i]);
+            yaxis = nurbs__vecMul(nurbs__vecNormalized(yaxis), radii[i]);
+        }
+
+        double *knots;
+        nurbs_HPoint *hpoints;
+        nurbs_CurveHandle h =
+            nurbs__storePush(store, type, 2, 2 * numArcs + 4,
+                             2 * numArcs + 1, &knots, &hpoints);
+        nurbs__makeEllipseArcFill(&centers[i], &xaxis, &yaxis, minAngle,
+                                  maxAngle, numArcs, knots, hpoints);
+        if (handles != NULL)
+            handles[i] = h;
+    }
+    return nurbs__storeCommit(store, first);
+}
+
+int nurbs__makeStoreLines(nurbs_CurveStore *store, const nurbs_Point *starts,
+                          const nurbs_Point *ends, size_t n,
+                          nurbs_CurveHandle *handles)
+{
+    assert(starts && ends);
+    if (!nurbs__storeReserve(store, n, 4 * n, 2 * n))
+        return NURBS_FALSE;
+
+    size_t first = nurbs_store_count(store);
+    for (size_t i = 0; i < n; ++i) {
+        double *knots;
+        nurbs_HPoint *hpoints;
+        nurbs_CurveHandle h = nurbs__storePush(store, NURBS_CURVE_LINE, 1, 4,
+                                               2, &knots, &hpoints);
+        knots[0] = knots[1] = 0.0;
+        knots[2] = knots[3] = 1.0;
+        hpoints[0] = nurbs__vec4(starts[i].x, starts[i].y, starts[i].z, 1.0);
+        hpoints[1] = nurbs__vec4(ends[i].x, ends[i].y, ends[i].z, 1.0);
+        if (handles != NULL)
+            handles[i] = h;
+    }
+    return nurbs__storeCommit(store, first);
+}
@@ -23,6 +23,8 @@
 #include "nurbs.h"
 #include "nurbs_internal.h"
 #include <assert.h>
+#include <math.h>
+#include <string.h>
 
 int nurbs__matAdd(const nurbs_Matrix a, const nurbs_Matrix b, nurbs_Matrix r)
 {
@@ -49,4 +51,290 @@ int nurbs__matDiv(const nurbs_Matrix a, const double b, nurbs_Matrix r)
         r[i + 1] = a[i + 1] / b;
     }
     return NURBS_TRUE;
-}
\ No newline at end of file
+}
+
+void nurbs__matIdentity4(nurbs_Matrix4 *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->m[0][0] = m->m[1][1] = m->m[2][2] = m->m[3][3] = 1.0;
+}
+
+void nurbs__matCompose4(const nurbs_Matrix4 *a, const nurbs_Matrix4 *b,
+                        nurbs_Matrix4 *r)
+{
+    nurbs_Matrix4 t;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            t.m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j] +
+                        a->m[i][2] * b->m[2][j] + a->m[i][3] * b->m[3][j];
+        }
+    }
+    *r = t;
+}
+
+int nurbs__matIsAffine4(const nurbs_Matrix4 *m)
+{
+    return m->m[3][0] == 0.0 && m->m[3][1] == 0.0 && m->m[3][2] == 0.0 &&
+           m->m[3][3] == 1.0;
+}
+
+int nurbs__matIsRigid4(const nurbs_Matrix4 *m)
+{
+    if (!nurbs__matIsAffine4(m))
+        return NURBS_FALSE;
+
+    /* columns orthonormal */
+    for (int i = 0; i < 3; ++i) {
+        for (int j = i; j < 3; ++j) {
+            double d = m->m[0][i] * m->m[0][j] + m->m[1][i] * m->m[1][j] +
+                       m->m[2][i] * m->m[2][j];
+            if (fabs(d - (i == j ? 1.0 : 0.0)) > NURBS__TOLERANCE)
+                return NURBS_FALSE;
+        }
+    }
+
+    /* no reflection */
+    const double(*a)[4] = m->m;
+    double det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+                 a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+                 a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    return det > 0.0;
+}
+
+/* largest absolute row sum of the leading n x n block */
+static double nurbs__matNorm4(const nurbs_Matrix4 *m, int n)
+{
+    double norm = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double sum = 0.0;
+        for (int j = 0; j < n; ++j)
+            sum += fabs(m->m[i][j]);
+        norm = sum > norm ? sum : norm;
+    }
+    return norm;
+}
+
+static int nurbs__matInvertAffine4(const nurbs_Matrix4 *m, nurbs_Matrix4 *r)
+{
+    const double(*a)[4] = m->m;
+    double c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+    double c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+    double c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+    double det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+    /* relative to the scale of the matrix, |det| <= norm^3 */
+    double norm = nurbs__matNorm4(m, 3);
+    if (fabs(det) <= NURBS__EPSILON * norm * norm * norm)
+        return NURBS_FALSE;
+
+    double id = 1.0 / det;
+    nurbs_Matrix4 t;
+    t.m[0][0] = c00 * id;
+    t.m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * id;
+    t.m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * id;
+    t.m[1][0] = c01 * id;
+    t.m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * id;
+    t.m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * id;
+    t.m[2][0] = c02 * id;
+    t.m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * id;
+    t.m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * id;
+
+    /* translation: -inverse(A) * t */
+    for (int i = 0; i < 3; ++i) {
+        t.m[i][3] = -(t.m[i][0] * a[0][3] + t.m[i][1] * a[1][3] +
+                      t.m[i][2] * a[2][3]);
+    }
+    t.m[3][0] = t.m[3][1] = t.m[3][2] = 0.0;
+    t.m[3][3] = 1.0;
+    *r = t;
+    return NURBS_TRUE;
+}
+
+int nurbs__matInvert4(const nurbs_Matrix4 *m, nurbs_Matrix4 *r)
+{
+    if (nurbs__matIsAffine4(m))
+        return nurbs__matInvertAffine4(m, r);
+
+    /* cofactors from the 2x2 minors of the upper and lower row pairs */
+    const double(*a)[4] = m->m;
+    double s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+    double s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+    double s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+    double s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+    double s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+    double s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+    double c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+    double c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+    double c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+    double c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+    double c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+    double c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+
+    double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    double norm = nurbs__matNorm4(m, 4);
+    if (fabs(det) <= NURBS__EPSILON * norm * norm * norm * norm)
+        return NURBS_FALSE;
+
+    double id = 1.0 / det;
+    nurbs_Matrix4 t;
+    t.m[0][0] = (a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * id;
+    t.m[0][1] = (-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * id;
+    t.m[0][2] = (a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * id;
+    t.m[0][3] = (-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * id;
+    t.m[1][0] = (-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * id;
+    t.m[1][1] = (a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * id;
+    t.m[1][2] = (-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * id;
+    t.m[1][3] = (a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * id;
+    t.m[2][0] = (a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * id;
+    t.m[2][1] = (-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * id;
+    t.m[2][2] = (a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * id;
+    t.m[2][3] = (-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * id;
+    t.m[3][0] = (-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * id;
+    t.m[3][1] = (a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * id;
+    t.m[3][2] = (-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * id;
+    t.m[3][3] = (a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * id;
+    *r = t;
+    return NURBS_TRUE;
+}
+
+nurbs_Point nurbs__matTransformPoint(const nurbs_Matrix4 *m, nurbs_Point p)
+{
+    const double(*a)[4] = m->m;
+    nurbs_Point r;
+    r.x = a[0][0] * p.x + a[0][1] * p.y + a[0][2] * p.z + a[0][3];
+    r.y = a[1][0] * p.x + a[1][1] * p.y + a[1][2] * p.z + a[1][3];
+    r.z = a[2][0] * p.x + a[2][1] * p.y + a[2][2] * p.z + a[2][3];
+    if (!nurbs__matIsAffine4(m)) {
+        double w = a[3][0] * p.x + a[3][1] * p.y + a[3][2] * p.z + a[3][3];
+        r = nurbs__vecDiv(r, w);
+    }
+    return r;
+}
+
+nurbs_Vector nurbs__matTransformVector(const nurbs_Matrix4 *m, nurbs_Vector v)
+{
+    const double(*a)[4] = m->m;
+    nurbs_Vector r;
+    r.x = a[0][0] * v.x + a[0][1] * v.y + a[0][2] * v.z;
+    r.y = a[1][0] * v.x + a[1][1] * v.y + a[1][2] * v.z;
+    r.z = a[2][0] * v.x + a[2][1] * v.y + a[2][2] * v.z;
+    return r;
+}
+
+void nurbs__matTransformCurve(nurbs_CurveData *data, const nurbs_Matrix4 *m)
+{
+    assert(data && data->cv);
+
+    /* homogeneous points transform linearly, affine or projective alike */
+    nurbs__kernels()->transform(data->cv->hpoints, data->cv->npoints,
+                                &m->m[0][0]);
+}
+
+int nurbs__matBandDecompose(double *a, size_t n, size_t ml, size_t mu)
+{
+    size_t w = ml + mu + 1;
+#define NURBS__BAND(i, j) a[(i) * w + (j) - (i) + ml]
+
+    for (size_t k = 0; k < n; ++k) {
+        double pivot = NURBS__BAND(k, k);
+        if (fabs(pivot) < NURBS__EPSILON)
+            return NURBS_FALSE;
+
+        size_t iend = k + ml < n - 1 ? k + ml : n - 1;
+        size_t jend = k + mu < n - 1 ? k + mu : n - 1;
+        for (size_t i = k + 1; i <= iend; ++i) {
+            double l = NURBS__BAND(i, k) / pivot;
+            NURBS__BAND(i, k) = l;
+            if (l == 0.0)
+                continue;
+            for (size_t j = k + 1; j <= jend; ++j)
+                NURBS__BAND(i, j) -= l * NURBS__BAND(k, j);
+        }
+    }
+    return NURBS_TRUE;
+}
+
+void nurbs__matBandSolve(const double *a, size_t n, size_t ml, size_t mu,
+                         double *b, size_t nrhs)
+{
+    size_t w = ml + mu + 1;
+
+    /* forward, L y = b */
+    for (size_t i = 1; i < n; ++i) {
+        size_t j = i > ml ? i - ml : 0;
+        for (; j < i; ++j) {
+            double l = NURBS__BAND(i, j);
+            for (size_t r = 0; r < nrhs; ++r)
+                b[i * nrhs + r] -= l * b[j * nrhs + r];
+        }
+    }
+
+    /* backward, U x = y */
+    for (size_t i = n; i-- > 0;) {
+        size_t jend = i + mu < n - 1 ? i + mu : n - 1;
+        for (size_t j = i + 1; j <= jend; ++j) {
+            double u = NURBS__BAND(i, j);
+            for (size_t r = 0; r < nrhs; ++r)
+                b[i * nrhs + r] -= u * b[j * nrhs + r];
+        }
+        for (size_t r = 0; r < nrhs; ++r)
+            b[i * nrhs + r] /= NURBS__BAND(i, i);
+    }
+#undef NURBS__BAND
+}
+
+int nurbs__matBandCholesky(double *a, size_t n, size_t m)
+{
+    size_t w = m + 1;
+#define NURBS__LBAND(i, j) a[(i) * w + (j) - (i) + m]
+
+    for (size_t j = 0; j < n; ++j) {
+        size_t k0 = j > m ? j - m : 0;
+        double d = NURBS__LBAND(j, j);
+        for (size_t k = k0; k < j; ++k)
+            d -= NURBS__LBAND(j, k) * NURBS__LBAND(j, k);
+        if (d <= 0.0)
+            return NURBS_FALSE;
+        d = sqrt(d);
+        NURBS__LBAND(j, j) = d;
+
+        size_t iend = j + m < n - 1 ? j + m : n - 1;
+        for (size_t i = j + 1; i <= iend; ++i) {
+            size_t k1 = i > m ? i - m : 0;
+            double s = NURBS__LBAND(i, j);
+            for (size_t k = k1 > k0 ? k1 : k0; k < j; ++k)
+                s -= NURBS__LBAND(i, k) * NURBS__LBAND(j, k);
+            NURBS__LBAND(i, j) = s / d;
+        }
+    }
+    return NURBS_TRUE;
+}
+
+void nurbs__matBandCholeskySolve(const double *a, size_t n, size_t m,
+                                 double *b, size_t nrhs)
+{
+    size_t w = m + 1;
+
+    /* forward, L y = b */
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i > m ? i - m : 0; j < i; ++j) {
+            double l = NURBS__LBAND(i, j);
+            for (size_t r = 0; r < nrhs; ++r)
+                b[i * nrhs + r] -= l * b[j * nrhs + r];
+        }
+        for (size_t r = 0; r < nrhs; ++r)
+            b[i * nrhs + r] /= NURBS__LBAND(i, i);
+    }
+
+    /* backward, L^T x = y */
+    for (size_t i = n; i-- > 0;) {
+        size_t jend = i + m < n - 1 ? i + m : n - 1;
+        for (size_t j = i + 1; j <= jend; ++j) {
+            double l = NURBS__LBAND(j, i);
+            for (size_t r = 0; r < nrhs; ++r)
+                b[i * nrhs + r] -= l * b[j * nrhs + r];
+        }
+        for (size_t r = 0; r < nrhs; ++r)
+            b[i * nrhs + r] /= NURBS__LBAND(i, i);
+    }
+#undef NURBS__LBAND
+}
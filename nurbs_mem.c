@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* sits right below every block handed out, keeping the payload aligned */
+typedef union {
+    struct {
+        const nurbs_Allocator *allocator; /* allocator the block came from */
+        size_t size;                      /* payload size */
+    } h;
+    unsigned char pad[NURBS__ALIGN];
+} nurbs__MemHeader;
+
+static void *nurbs__memDefaultAlloc(void *user, size_t size, size_t align)
+{
+    (void)user;
+#if defined(_WIN32)
+    return _aligned_malloc(size, align);
+#else
+    void *p = NULL;
+    if (posix_memalign(&p, align, size) != 0)
+        return NULL;
+    return p;
+#endif
+}
+
+static void nurbs__memDefaultFree(void *user, void *ptr, size_t size)
+{
+    (void)user;
+    (void)size;
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static const nurbs_Allocator nurbs__memDefault = {
+    nurbs__memDefaultAlloc, NULL, nurbs__memDefaultFree, NULL};
+
+static const nurbs_Allocator *nurbs__memGlobal = &nurbs__memDefault;
+static NURBS__THREADLOCAL const nurbs_Allocator *nurbs__memThread = NULL;
+
+void nurbs__memSetGlobal(const nurbs_Allocator *allocator)
+{
+    nurbs__memGlobal = allocator ? allocator : &nurbs__memDefault;
+}
+
+const nurbs_Allocator *nurbs__memSetThread(const nurbs_Allocator *allocator)
+{
+    const nurbs_Allocator *previous = nurbs__memThread;
+    nurbs__memThread = allocator;
+    return previous;
+}
+
+static void *nurbs__memAllocFrom(const nurbs_Allocator *a, size_t size)
+{
+    if (size > SIZE_MAX - sizeof(nurbs__MemHeader))
+        return NULL;
+    nurbs__MemHeader *hdr = (nurbs__MemHeader *)a->alloc(
+        a->user, sizeof(nurbs__MemHeader) + size, NURBS__ALIGN);
+    if (hdr == NULL)
+        return NULL;
+    hdr->h.allocator = a;
+    hdr->h.size = size;
+    return hdr + 1;
+}
+
+void *nurbs__memAlloc(size_t size)
+{
+    const nurbs_Allocator *a = nurbs__memThread;
+    return nurbs__memAllocFrom(a ? a : nurbs__memGlobal, size);
+}
+
+void *nurbs__memCalloc(size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size)
+        return NULL;
+    void *p = nurbs__memAlloc(n * size);
+    if (p != NULL)
+        memset(p, 0, n * size);
+    return p;
+}
+
+void *nurbs__memRealloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return nurbs__memAlloc(size);
+
+    /* the block stays with the allocator it came from */
+    nurbs__MemHeader *hdr = (nurbs__MemHeader *)ptr - 1;
+    const nurbs_Allocator *a = hdr->h.allocator;
+    size_t oldsize = hdr->h.size;
+
+    if (a->realloc != NULL) {
+        if (size > SIZE_MAX - sizeof(nurbs__MemHeader))
+            return NULL;
+        hdr = (nurbs__MemHeader *)a->realloc(
+            a->user, hdr, sizeof(nurbs__MemHeader) + oldsize,
+            sizeof(nurbs__MemHeader) + size, NURBS__ALIGN);
+        if (hdr == NULL)
+            return NULL;
+        hdr->h.size = size;
+        return hdr + 1;
+    }
+
+    void *p = nurbs__memAllocFrom(a, size);
+    if (p == NULL)
+        return NULL;
+    memcpy(p, ptr, oldsize < size ? oldsize : size);
+    nurbs__memFree(ptr);
+    return p;
+}
+
+void nurbs__memFree(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    nurbs__MemHeader *hdr = (nurbs__MemHeader *)ptr - 1;
+    const nurbs_Allocator *a = hdr->h.allocator;
+    a->free(a->user, hdr, sizeof(nurbs__MemHeader) + hdr->h.size);
+}
+
+/* scratch chunks, the payload follows the padded header */
+struct nurbs__MemChunk {
+    struct nurbs__MemChunk *next; /* next cached chunk */
+    size_t size;                  /* payload size */
+    size_t used;                  /* bytes handed out */
+};
+
+#define NURBS__CHUNKHEADER                                              \
+    ((sizeof(struct nurbs__MemChunk) + NURBS__ALIGN - 1) &             \
+     ~(size_t)(NURBS__ALIGN - 1))
+
+/* chunks up to cur hold live scratch, the ones after are kept for reuse */
+static NURBS__THREADLOCAL struct {
+    struct nurbs__MemChunk *head;
+    struct nurbs__MemChunk *cur;
+} nurbs__memScratch;
+
+nurbs__MemMark nurbs__memScratchMark(void)
+{
+    nurbs__MemMark mark;
+    mark.chunk = nurbs__memScratch.cur;
+    mark.used = mark.chunk ? mark.chunk->used : 0;
+    return mark;
+}
+
+void nurbs__memScratchRelease(nurbs__MemMark mark)
+{
+    nurbs__memScratch.cur = mark.chunk;
+    if (mark.chunk != NULL)
+        mark.chunk->used = mark.used;
+}
+
+void *nurbs__memScratchAlloc(size_t size)
+{
+    struct nurbs__MemChunk *c = nurbs__memScratch.cur;
+
+    if (size > SIZE_MAX - NURBS__ALIGN - NURBS__CHUNKHEADER)
+        return NULL;
+    size = (size + NURBS__ALIGN - 1) & ~(size_t)(NURBS__ALIGN - 1);
+    if (c != NULL && c->size - c->used >= size) {
+        void *p = (unsigned char *)c + NURBS__CHUNKHEADER + c->used;
+        c->used += size;
+        return p;
+    }
+
+    /* move on to the next cached chunk, dropping ones that are too small */
+    struct nurbs__MemChunk **link = c ? &c->next : &nurbs__memScratch.head;
+    while (*link != NULL && (*link)->size < size) {
+        struct nurbs__MemChunk *d = *link;
+        *link = d->next;
+        nurbs__memFree(d);
+    }
+    if (*link == NULL) {
+        size_t csize = c ? 2 * c->size : NURBS__SCRATCHCHUNK;
+        if (csize < size)
+            csize = size;
+        /* cached chunks outlive any thread allocator, e.g. a request arena
+           dropped as a whole, so they come from the global one */
+        struct nurbs__MemChunk *n =
+            (struct nurbs__MemChunk *)nurbs__memAllocFrom(
+                nurbs__memGlobal, NURBS__CHUNKHEADER + csize);
+        if (n == NULL)
+            return NULL;
+        n->next = NULL;
+        n->size = csize;
+        *link = n;
+    }
+
+    c = *link;
+    c->used = size;
+    nurbs__memScratch.cur = c;
+    return (unsigned char *)c + NURBS__CHUNKHEADER;
+}
+
+void nurbs__memScratchTrim(void)
+{
+    struct nurbs__MemChunk **link = nurbs__memScratch.cur
+                                        ? &nurbs__memScratch.cur->next
+                                        : &nurbs__memScratch.head;
+    while (*link != NULL) {
+        struct nurbs__MemChunk *d = *link;
+        *link = d->next;
+        nurbs__memFree(d);
+    }
+}
@@ -20,4 +20,44 @@
  * IN THE SOFTWARE.
  */
 
-#include "nurbs_internal.h"
\ No newline at end of file
+#include "nurbs_internal.h"
+#include <assert.h>
+
+/*
+ * The Bezier points of span [a, b) are the blossom values
+ * P(a, ..., a, b, ..., b), evaluated here with de Boor's algorithm restricted
+ * to the p + 1 control points that act on the span. Only local data is read,
+ * so spans can be extracted one at a time without refining the whole curve.
+ */
+void nurbs__modifySpanBezier(const nurbs_CurveData *data, size_t span,
+                             double *bezier)
+{
+    double Q[NURBS__MAXDEGREE + 1][4];
+    const double *U = data->knots;
+    const nurbs_HPoint *pts = data->cv->hpoints;
+    size_t p = data->degree;
+    double a = U[span], b = U[span + 1];
+
+    assert(p <= NURBS__MAXDEGREE);
+
+    for (size_t i = 0; i <= p; ++i) {
+        for (size_t j = 0; j <= p; ++j) {
+            const nurbs_HPoint *pt = &pts[span - p + j];
+            Q[j][0] = pt->x;
+            Q[j][1] = pt->y;
+            Q[j][2] = pt->z;
+            Q[j][3] = pt->w;
+        }
+        for (size_t r = 1; r <= p; ++r) {
+            double t = r <= p - i ? a : b;
+            for (size_t j = p; j >= r; --j) {
+                size_t k = span - p + j;
+                double alpha = (t - U[k]) / (U[k + p + 1 - r] - U[k]);
+                for (size_t c = 0; c < 4; ++c)
+                    Q[j][c] = (1.0 - alpha) * Q[j - 1][c] + alpha * Q[j][c];
+            }
+        }
+        for (size_t c = 0; c < 4; ++c)
+            bezier[4 * i + c] = Q[p][c];
+    }
+}
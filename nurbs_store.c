@@ -0,0 +1,297 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nurbs_internal.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NURBS__STORENONE UINT32_MAX
+
+static size_t nurbs__storeGrow(size_t capacity, size_t needed)
+{
+    size_t c = capacity ? capacity : 16;
+    while (c < needed)
+        c *= 2;
+    return c;
+}
+
+static int nurbs__storeResize(void **p, size_t *capacity, size_t needed,
+                              size_t elsize)
+{
+    if (needed <= *capacity)
+        return NURBS_TRUE;
+    size_t c = nurbs__storeGrow(*capacity, needed);
+    void *q = nurbs__memRealloc(*p, c * elsize);
+    if (q == NULL)
+        return NURBS_FALSE;
+    *p = q;
+    *capacity = c;
+    return NURBS_TRUE;
+}
+
+nurbs_CurveStore *nurbs__storeNew(size_t ncurves, size_t nknots,
+                                  size_t npoints)
+{
+    nurbs_CurveStore *store =
+        (nurbs_CurveStore *)nurbs__memCalloc(1, sizeof(nurbs_CurveStore));
+    if (store == NULL)
+        return NULL;
+    store->freeslot = NURBS__STORENONE;
+
+    if (!nurbs__storeReserve(store, ncurves, nknots, npoints)) {
+        nurbs__storeFree(store);
+        return NULL;
+    }
+    return store;
+}
+
+void nurbs__storeFree(nurbs_CurveStore *store)
+{
+    if (store == NULL)
+        return;
+    for (size_t i = 0; i < store->nrecords; ++i)
+        nurbs__memFree(store->records[i].kindex);
+    nurbs__memFree(store->records);
+    nurbs__memFree(store->knots);
+    nurbs__memFree(store->hpoints);
+    nurbs__memFree(store->slots);
+    nurbs__memFree(store);
+}
+
+int nurbs__storeReserve(nurbs_CurveStore *store, size_t ncurves,
+                        size_t nknots, size_t npoints)
+{
+    /* a handle slot per curve at most, slot indices are 32 bit */
+    if (store->nrecords + ncurves >= NURBS__STORENONE)
+        return NURBS_FALSE;
+
+    if (!nurbs__storeResize((void **)&store->records, &store->crecords,
+                            store->nrecords + ncurves,
+                            sizeof(nurbs__StoreRecord)) ||
+        !nurbs__storeResize((void **)&store->slots, &store->cslots,
+                            store->nrecords + ncurves,
+                            sizeof(nurbs__StoreSlot)) ||
+        !nurbs__storeResize((void **)&store->knots, &store->cknots,
+                            store->nknots + nknots, sizeof(double)) ||
+        !nurbs__storeResize((void **)&store->hpoints, &store->cpoints,
+                            store->npoints + npoints, sizeof(nurbs_HPoint)))
+        return NURBS_FALSE;
+    return NURBS_TRUE;
+}
+
+nurbs_CurveHandle nurbs__storePush(nurbs_CurveStore *store, int type,
+                                   uint8_t degree, size_t nknots,
+                                   size_t npoints, double **knots,
+                                   nurbs_HPoint **hpoints)
+{
+    assert(store->nrecords < store->crecords);
+    assert(store->nknots + nknots <= store->cknots);
+    assert(store->npoints + npoints <= store->cpoints);
+
+    /* live slots never outnumber records, so a fresh slot fits */
+    uint32_t slot = store->freeslot;
+    if (slot != NURBS__STORENONE) {
+        store->freeslot = store->slots[slot].index;
+    }
+    else {
+        assert(store->nslots < store->cslots);
+        slot = (uint32_t)store->nslots++;
+        store->slots[slot].generation = 1;
+    }
+    store->slots[slot].index = (uint32_t)store->nrecords;
+
+    nurbs__StoreRecord *r = &store->records[store->nrecords++];
+    r->type = type;
+    r->degree = degree;
+    r->nknots = (uint32_t)nknots;
+    r->npoints = (uint32_t)npoints;
+    r->slot = slot;
+    r->knots = store->nknots;
+    r->hpoints = store->npoints;
+    r->kindex = NULL;
+    store->nknots += nknots;
+    store->npoints += npoints;
+
+    *knots = store->knots + r->knots;
+    *hpoints = store->hpoints + r->hpoints;
+    return NURBS__STOREHANDLE(slot, store->slots[slot].generation);
+}
+
+static void nurbs__storeReleaseSlot(nurbs_CurveStore *store, uint32_t slot)
+{
+    nurbs__StoreSlot *s = &store->slots[slot];
+    /* generation 0 is never handed out, so handle 0 stays invalid */
+    if (++s->generation == 0)
+        s->generation = 1;
+    s->index = store->freeslot;
+    store->freeslot = slot;
+}
+
+int nurbs__storeCommit(nurbs_CurveStore *store, size_t first)
+{
+    for (size_t i = first; i < store->nrecords; ++i) {
+        nurbs__StoreRecord *r = &store->records[i];
+        if (r->nknots - 2 * (size_t)r->degree - 1 < NURBS__KINDEXMIN)
+            continue;
+
+        nurbs_CurveView view;
+        nurbs__storeView(store, i, &view);
+        r->kindex = nurbs__evalBuildKnotIndex(&view.data);
+        if (r->kindex == NULL) {
+            nurbs__storeTruncate(store, first);
+            return NURBS_FALSE;
+        }
+    }
+    return NURBS_TRUE;
+}
+
+void nurbs__storeTruncate(nurbs_CurveStore *store, size_t nrecords)
+{
+    if (nrecords >= store->nrecords)
+        return;
+
+    /* release in reverse so the free list hands slots out in order again */
+    for (size_t i = store->nrecords; i-- > nrecords;) {
+        nurbs__memFree(store->records[i].kindex);
+        nurbs__storeReleaseSlot(store, store->records[i].slot);
+    }
+    store->nknots = store->records[nrecords].knots;
+    store->npoints = store->records[nrecords].hpoints;
+    store->nrecords = nrecords;
+}
+
+int nurbs__storeAppend(nurbs_CurveStore *store,
+                       const nurbs_Curve *const *curves, size_t n,
+                       nurbs_CurveHandle *handles)
+{
+    size_t nknots = 0, npoints = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const nurbs_CurveData *data = curves[i]->nurbs_data;
+        nknots += data->nknots;
+        npoints += data->cv->npoints;
+    }
+    if (!nurbs__storeReserve(store, n, nknots, npoints))
+        return NURBS_FALSE;
+
+    size_t first = store->nrecords;
+    for (size_t i = 0; i < n; ++i) {
+        const nurbs_CurveData *data = curves[i]->nurbs_data;
+        double *knots;
+        nurbs_HPoint *hpoints;
+        nurbs_CurveHandle h = nurbs__storePush(
+            store, curves[i]->type, data->degree, data->nknots,
+            data->cv->npoints, &knots, &hpoints);
+        memcpy(knots, data->knots, data->nknots * sizeof(double));
+        memcpy(hpoints, data->cv->hpoints,
+               data->cv->npoints * sizeof(nurbs_HPoint));
+        if (handles != NULL)
+            handles[i] = h;
+    }
+    return nurbs__storeCommit(store, first);
+}
+
+size_t nurbs__storeRemove(nurbs_CurveStore *store,
+                          const nurbs_CurveHandle *handles, size_t n)
+{
+    size_t removed = 0;
+    size_t first = store->nrecords;
+
+    /* mark, the released slot makes repeated handles stale */
+    for (size_t i = 0; i < n; ++i) {
+        size_t index;
+        if (!nurbs__storeLookup(store, handles[i], &index))
+            continue;
+        nurbs__StoreRecord *r = &store->records[index];
+        nurbs__storeReleaseSlot(store, r->slot);
+        nurbs__memFree(r->kindex);
+        r->kindex = NULL;
+        r->slot = NURBS__STORENONE;
+        if (index < first)
+            first = index;
+        ++removed;
+    }
+    if (removed == 0)
+        return 0;
+
+    /* compact everything after the first hole, pools keep record order so
+     * data only ever moves down */
+    size_t w = first;
+    size_t wknots = store->records[first].knots;
+    size_t wpoints = store->records[first].hpoints;
+    for (size_t i = first; i < store->nrecords; ++i) {
+        nurbs__StoreRecord r = store->records[i];
+        if (r.slot == NURBS__STORENONE)
+            continue;
+        if (r.knots != wknots) {
+            memmove(store->knots + wknots, store->knots + r.knots,
+                    r.nknots * sizeof(double));
+            r.knots = wknots;
+        }
+        if (r.hpoints != wpoints) {
+            memmove(store->hpoints + wpoints, store->hpoints + r.hpoints,
+                    r.npoints * sizeof(nurbs_HPoint));
+            r.hpoints = wpoints;
+        }
+        wknots += r.nknots;
+        wpoints += r.npoints;
+        store->slots[r.slot].index = (uint32_t)w;
+        store->records[w++] = r;
+    }
+    store->nrecords = w;
+    store->nknots = wknots;
+    store->npoints = wpoints;
+    return removed;
+}
+
+int nurbs__storeLookup(const nurbs_CurveStore *store, nurbs_CurveHandle handle,
+                       size_t *index)
+{
+    uint32_t slot = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32);
+
+    if (slot >= store->nslots || generation == 0)
+        return NURBS_FALSE;
+    const nurbs__StoreSlot *s = &store->slots[slot];
+    /* a free slot has moved on to the next generation */
+    if (s->generation != generation)
+        return NURBS_FALSE;
+    *index = s->index;
+    return NURBS_TRUE;
+}
+
+void nurbs__storeView(const nurbs_CurveStore *store, size_t index,
+                      nurbs_CurveView *view)
+{
+    assert(index < store->nrecords);
+    const nurbs__StoreRecord *r = &store->records[index];
+
+    view->cv.npoints = r->npoints;
+    view->cv.hpoints = store->hpoints + r->hpoints;
+    view->data.degree = r->degree;
+    view->data.nknots = r->nknots;
+    view->data.knots = store->knots + r->knots;
+    view->data.cv = &view->cv;
+    view->data.kindex = r->kindex;
+    view->curve.type = NURBS_CURVE_NURBS;
+    view->curve.nurbs_data = &view->data;
+}
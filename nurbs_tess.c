@@ -20,4 +20,591 @@
  * IN THE SOFTWARE.
  */
 
-#include "nurbs_internal.h"
\ No newline at end of file
+#include "nurbs_internal.h"
+#include <math.h>
+
+/* doubles of inline stack storage, enough for a deep cubic subdivision */
+#define NURBS__TESSINLINE 1024
+/* most pieces a failing piece is split into at once */
+#define NURBS__TESSMAXSPLIT 16
+/* pieces narrower than this fraction of their span are accepted as is */
+#define NURBS__TESSMINWIDTH 1e-9
+
+/*
+ * A piece on the stack is its width relative to the span followed by its
+ * degree + 1 homogeneous Bezier control points.
+ */
+typedef struct {
+    double width;
+    double hp[];
+} nurbs__TessPiece;
+
+/*
+ * Resumable adaptive tessellation, see nurbs__tessSpan. The stack holds the
+ * pieces of the current span still to refine, leftmost on top, so between
+ * calls only O(depth) pieces are kept whatever the length of the curve.
+ */
+struct nurbs__TessIter {
+    const nurbs_CurveData *data; /* curve being tessellated */
+    nurbs_TessTolerance tol;     /* tolerance */
+    size_t span;                 /* next knot span to start */
+    int done;                    /* the end point was produced */
+    nurbs_array_t stack;         /* pieces of the current span */
+};
+
+/* points of one knot span in the pool of a tessellation */
+typedef struct {
+    size_t offset;   /* first point in the pool */
+    size_t count;    /* points of the span, its end point excluded */
+    size_t capacity; /* points reserved for the span at offset */
+} nurbs__TessRange;
+
+/*
+ * Tessellation that remembers where each knot span put its points, so an
+ * edit re-tessellates only the spans it touched. A span that outgrows its
+ * room moves to the end of the pool with twice the room, the pool is
+ * compacted when the holes left behind outweigh the points.
+ */
+struct nurbs__Tessellation {
+    const nurbs_CurveData *data; /* curve being tessellated */
+    nurbs_TessTolerance tol;     /* tolerance */
+    size_t nspans;               /* knot spans of the domain, empty included */
+    nurbs__TessRange *ranges;    /* nspans ranges */
+    nurbs_array_t pool;          /* points of all spans */
+    size_t npoints;              /* points in all ranges */
+    nurbs_Point end;             /* end point of the curve */
+};
+
+static inline nurbs_Point nurbs__tessCartesian(const double *hp)
+{
+    nurbs_Point pt;
+    pt.x = hp[0] / hp[3];
+    pt.y = hp[1] / hp[3];
+    pt.z = hp[2] / hp[3];
+    return pt;
+}
+
+/* distance from pt to the segment [a, b] */
+static double nurbs__tessSegmentDistance(nurbs_Point pt, nurbs_Point a,
+                                         nurbs_Vector ab, double ab2)
+{
+    nurbs_Vector ap = nurbs__vecSub(pt, a);
+    double t = ab2 > 0.0 ? nurbs__vecDot(ap, ab) / ab2 : 0.0;
+    t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+    return nurbs__vecNorm(nurbs__vecSub(ap, nurbs__vecMul(ab, t)));
+}
+
+/*
+ * Number of pieces the Bezier needs, 1 if it is within tolerance.
+ *
+ * A point of the curve is the average of the control points weighted by
+ * w_i B_i(t), so its distance to the chord is at most the largest distance
+ * h of an inner control point times the share S(t) of the inner terms. The
+ * inner Bernstein polynomials sum to at most 1 - 2^(1 - p), which with the
+ * weights bounds S; for quadratic arcs the bound is exact. The tangent lies
+ * in the cone of the control polygon legs, so their angle to the chord
+ * bounds the angular error. The errors fall quadratically, respectively
+ * linearly, with the piece width, which estimates the split.
+ */
+static size_t nurbs__tessPieces(const double *hp, size_t p,
+                                const nurbs_TessTolerance *tol)
+{
+    nurbs_Point a = nurbs__tessCartesian(hp);
+    nurbs_Point b = nurbs__tessCartesian(hp + 4 * p);
+    nurbs_Vector ab = nurbs__vecSub(b, a);
+    double ab2 = nurbs__vecDot(ab, ab);
+
+    double height = 0.0, turn = 0.0, winner = 0.0;
+    nurbs_Point prev = a;
+    for (size_t i = 1; i <= p; ++i) {
+        nurbs_Point pt = nurbs__tessCartesian(hp + 4 * i);
+        if (i < p) {
+            height = fmax(height, nurbs__tessSegmentDistance(pt, a, ab, ab2));
+            winner = fmax(winner, hp[4 * i + 3]);
+        }
+        if (tol->angle > 0.0) {
+            nurbs_Vector leg = nurbs__vecSub(pt, prev);
+            double l2 = nurbs__vecDot(leg, leg);
+            if (l2 > 0.0 && ab2 > 0.0) {
+                double c = nurbs__vecDot(leg, ab) / sqrt(l2 * ab2);
+                turn = fmax(turn, acos(c > 1.0 ? 1.0 : c < -1.0 ? -1.0 : c));
+            }
+            else if (l2 > 0.0) {
+                /* closed piece, the chord has no direction */
+                turn = M_PI;
+            }
+        }
+        prev = pt;
+    }
+    if (height > 0.0) {
+        double inner = winner * (1.0 - ldexp(1.0, 1 - (int)p));
+        double outer = fmin(hp[3], hp[4 * p + 3]) * ldexp(1.0, 1 - (int)p);
+        height *= inner / (inner + outer);
+    }
+
+    /* rounding must not split a piece that meets the tolerance exactly */
+    double k = 1.0;
+    if (height > tol->chord * (1.0 + 1e-9))
+        k = ceil(sqrt(height / tol->chord));
+    if (tol->angle > 0.0 && turn > tol->angle * (1.0 + 1e-9))
+        k = fmax(k, ceil(turn / tol->angle));
+    if (k <= 1.0)
+        return 1;
+    return k < NURBS__TESSMAXSPLIT ? (size_t)k : NURBS__TESSMAXSPLIT;
+}
+
+/* de Casteljau split of hp at t, hp keeps [0, t] and right gets [t, 1] */
+static void nurbs__tessSplit(double *hp, size_t p, double t, double *right)
+{
+    for (size_t c = 0; c < 4; ++c)
+        right[4 * p + c] = hp[4 * p + c];
+    for (size_t r = 1; r <= p; ++r) {
+        for (size_t i = p; i >= r; --i) {
+            for (size_t c = 0; c < 4; ++c) {
+                hp[4 * i + c] =
+                    (1.0 - t) * hp[4 * (i - 1) + c] + t * hp[4 * i + c];
+            }
+        }
+        for (size_t c = 0; c < 4; ++c)
+            right[4 * (p - r) + c] = hp[4 * p + c];
+    }
+}
+
+/*
+ * Whether the n homogeneous points lie behind one plane of the clip region,
+ * and with them their convex hull, which holds the curve they control. With
+ * positive weights the side of (x, y, z, w) is that of w * (dot(n, p) - d).
+ */
+static int nurbs__tessCulled(const double *hp, size_t n,
+                             const nurbs_ClipRegion *clip)
+{
+    for (size_t j = 0; j < clip->nplanes; ++j) {
+        const nurbs_Plane *plane = &clip->planes[j];
+        double d = nurbs__vecDot(plane->normal, plane->origin);
+        size_t i = 0;
+        while (i < n && plane->normal.x * hp[4 * i] +
+                                plane->normal.y * hp[4 * i + 1] +
+                                plane->normal.z * hp[4 * i + 2] <
+                            d * hp[4 * i + 3])
+            ++i;
+        if (i == n)
+            return NURBS_TRUE;
+    }
+    return NURBS_FALSE;
+}
+
+/* start a span with its whole Bezier form on the stack */
+static int nurbs__tessStart(nurbs_array_t *stack, const nurbs_CurveData *data,
+                            size_t span)
+{
+    nurbs__TessPiece *piece = (nurbs__TessPiece *)nurbs_array_push(stack);
+    if (piece == NULL)
+        return NURBS_FALSE;
+    piece->width = 1.0;
+    nurbs__modifySpanBezier(data, span, piece->hp);
+    return NURBS_TRUE;
+}
+
+/*
+ * Split the top of the stack until it meets the tolerance, then pop it and
+ * return its start point. 1 if a point was produced, 0 if the stack is
+ * empty and -1 if out of memory. With a clip region, a piece outside it is
+ * popped as soon as it is seen, returning 2 and its start point.
+ */
+static int nurbs__tessRefine(nurbs_array_t *stack, size_t p,
+                             const nurbs_TessTolerance *tol,
+                             const nurbs_ClipRegion *clip, nurbs_Point *pt)
+{
+    size_t esize = stack->size;
+
+    while (stack->nelts) {
+        size_t at = stack->nelts - 1;
+        nurbs__TessPiece *piece =
+            (nurbs__TessPiece *)(stack->elts + at * esize);
+        if (clip != NULL && nurbs__tessCulled(piece->hp, p + 1, clip)) {
+            *pt = nurbs__tessCartesian(piece->hp);
+            nurbs_array_pop(stack);
+            return 2;
+        }
+        size_t k = nurbs__tessPieces(piece->hp, p, tol);
+        if (k == 1 || piece->width < NURBS__TESSMINWIDTH) {
+            *pt = nurbs__tessCartesian(piece->hp);
+            nurbs_array_pop(stack);
+            return 1;
+        }
+
+        /* the rightmost piece replaces this one and the leftmost ends on
+           top, peeled off the right end of the piece copied there */
+        if (nurbs_array_pushn(stack, k - 1) == NULL)
+            return -1;
+        piece = (nurbs__TessPiece *)(stack->elts + at * esize);
+        double width = piece->width / (double)k;
+        nurbs__TessPiece *top =
+            (nurbs__TessPiece *)(stack->elts + (stack->nelts - 1) * esize);
+        memcpy(top, piece, esize);
+        for (size_t i = 0; i + 1 < k; ++i) {
+            nurbs__TessPiece *right =
+                (nurbs__TessPiece *)(stack->elts + (at + i) * esize);
+            nurbs__tessSplit(top->hp, p, (double)(k - 1 - i) / (double)(k - i),
+                             right->hp);
+            right->width = width;
+        }
+        top->width = width;
+    }
+    return 0;
+}
+
+int nurbs__tessSpan(const nurbs_CurveData *data, size_t span,
+                    const nurbs_TessTolerance *tol, nurbs__Out *out)
+{
+    double inl[NURBS__TESSINLINE];
+    size_t p = data->degree;
+    size_t esize = sizeof(nurbs__TessPiece) + 4 * (p + 1) * sizeof(double);
+    nurbs_array_t stack;
+    nurbs_array_init_inline(&stack, NULL, esize, inl, sizeof(inl) / esize);
+
+    if (!nurbs__tessStart(&stack, data, span)) {
+        nurbs_array_destroy(&stack);
+        return NURBS_FALSE;
+    }
+    nurbs_Point pt;
+    int r;
+    while ((r = nurbs__tessRefine(&stack, p, tol, NULL, &pt)) > 0)
+        nurbs__outPush(out, &pt);
+
+    nurbs_array_destroy(&stack);
+    return r == 0;
+}
+
+int nurbs__tessCurve(const nurbs_CurveData *data,
+                     const nurbs_TessTolerance *tol, nurbs__Out *out)
+{
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+
+    if (!(tol->chord > 0.0) || !(tol->angle >= 0.0))
+        return NURBS_FALSE;
+
+    for (size_t k = p; k <= last; ++k) {
+        if (U[k] >= U[k + 1])
+            continue;
+        if (!nurbs__tessSpan(data, k, tol, out))
+            return NURBS_FALSE;
+    }
+    if (nurbs__outWanted(out)) {
+        nurbs_Point pt = nurbs__evalCurvePoint(data, U[last + 1]);
+        nurbs__outPush(out, &pt);
+    }
+    else {
+        nurbs__outSkip(out, 1);
+    }
+    return NURBS_TRUE;
+}
+
+int nurbs__tessClip(const nurbs_CurveData *data,
+                    const nurbs_TessTolerance *tol,
+                    const nurbs_ClipRegion *clip, nurbs__Out *points,
+                    nurbs__Out *runs)
+{
+    double inl[NURBS__TESSINLINE];
+    const double *U = data->knots;
+    const double *cv = (const double *)data->cv->hpoints;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+    size_t esize = sizeof(nurbs__TessPiece) + 4 * (p + 1) * sizeof(double);
+    nurbs_array_t stack;
+    nurbs_Point pt;
+    int open = 0, r = 0;
+
+    if (!(tol->chord > 0.0) || !(tol->angle >= 0.0))
+        return NURBS_FALSE;
+
+    nurbs_array_init_inline(&stack, NULL, esize, inl, sizeof(inl) / esize);
+    for (size_t k = p; k <= last && r == 0; ++k) {
+        if (U[k] >= U[k + 1])
+            continue;
+
+        /* the span lies in the hull of its control points, a span outside is
+           skipped without forming its Bezier, ending the run before it */
+        if (nurbs__tessCulled(cv + 4 * (k - p), p + 1, clip)) {
+            if (open) {
+                pt = nurbs__evalCurvePoint(data, U[k]);
+                nurbs__outPush(points, &pt);
+                open = 0;
+            }
+            continue;
+        }
+
+        if (!nurbs__tessStart(&stack, data, k)) {
+            r = -1;
+            break;
+        }
+        while ((r = nurbs__tessRefine(&stack, p, tol, clip, &pt)) > 0) {
+            if (r == 1 && !open) {
+                size_t at = points->count;
+                nurbs__outPush(runs, &at);
+                open = 1;
+            }
+            /* the start of a culled piece ends the segment before it */
+            if (open)
+                nurbs__outPush(points, &pt);
+            if (r == 2)
+                open = 0;
+        }
+    }
+    nurbs_array_destroy(&stack);
+    if (r < 0)
+        return NURBS_FALSE;
+
+    if (open) {
+        pt = nurbs__evalCurvePoint(data, U[last + 1]);
+        nurbs__outPush(points, &pt);
+    }
+    size_t at = points->count;
+    nurbs__outPush(runs, &at);
+    return NURBS_TRUE;
+}
+
+nurbs_TessIterator *nurbs__tessIterNew(const nurbs_CurveData *data,
+                                       const nurbs_TessTolerance *tol)
+{
+    if (!(tol->chord > 0.0) || !(tol->angle >= 0.0))
+        return NULL;
+
+    nurbs_TessIterator *it =
+        (nurbs_TessIterator *)nurbs__memAlloc(sizeof(nurbs_TessIterator));
+    if (it == NULL)
+        return NULL;
+    it->data = data;
+    it->tol = *tol;
+    it->span = data->degree;
+    it->done = 0;
+    nurbs_array_init(&it->stack, NULL,
+                     sizeof(nurbs__TessPiece) +
+                         4 * ((size_t)data->degree + 1) * sizeof(double),
+                     0);
+    return it;
+}
+
+int nurbs__tessIterNext(nurbs_TessIterator *it, nurbs_Point *points,
+                        size_t cap, size_t *n)
+{
+    const nurbs_CurveData *data = it->data;
+    const double *U = data->knots;
+    size_t p = data->degree;
+    size_t last = data->nknots - p - 2;
+
+    *n = 0;
+    while (*n < cap && !it->done) {
+        int r = nurbs__tessRefine(&it->stack, p, &it->tol, NULL,
+                                  &points[*n]);
+        if (r > 0) {
+            ++*n;
+            continue;
+        }
+        if (r < 0)
+            return NURBS_FALSE;
+
+        /* the span is done, start the next non empty one or finish */
+        while (it->span <= last && U[it->span] >= U[it->span + 1])
+            ++it->span;
+        if (it->span <= last) {
+            if (!nurbs__tessStart(&it->stack, data, it->span))
+                return NURBS_FALSE;
+            ++it->span;
+        }
+        else {
+            points[(*n)++] = nurbs__evalCurvePoint(data, U[last + 1]);
+            it->done = 1;
+        }
+    }
+    return NURBS_TRUE;
+}
+
+void nurbs__tessIterFree(nurbs_TessIterator *it)
+{
+    if (it == NULL)
+        return;
+    nurbs_array_destroy(&it->stack);
+    nurbs__memFree(it);
+}
+
+/* tessellate a span into its range, moving it to the end if it outgrew it */
+static int nurbs__tessRetessellate(nurbs_Tessellation *t, size_t span)
+{
+    const nurbs_CurveData *data = t->data;
+    nurbs__TessRange *range = &t->ranges[span];
+    size_t k = span + data->degree;
+    nurbs__Out out;
+
+    t->npoints -= range->count;
+    range->count = 0;
+    if (data->knots[k] >= data->knots[k + 1])
+        return NURBS_TRUE;
+
+    nurbs__outInit(&out, t->pool.elts + range->offset * sizeof(nurbs_Point),
+                   sizeof(nurbs_Point), 0, range->capacity);
+    if (!nurbs__tessSpan(data, k, &t->tol, &out))
+        return NURBS_FALSE;
+    if (out.count > range->capacity) {
+        size_t count = out.count, offset = t->pool.nelts;
+        if (nurbs_array_pushn(&t->pool, 2 * count) == NULL)
+            return NURBS_FALSE;
+        nurbs__outInit(&out, t->pool.elts + offset * sizeof(nurbs_Point),
+                       sizeof(nurbs_Point), 0, count);
+        if (!nurbs__tessSpan(data, k, &t->tol, &out))
+            return NURBS_FALSE;
+        range->offset = offset;
+        range->capacity = 2 * count;
+    }
+    range->count = out.count;
+    t->npoints += out.count;
+    return NURBS_TRUE;
+}
+
+/* close the holes of the pool, ranges keep their points and lose the slack */
+static int nurbs__tessCompact(nurbs_Tessellation *t)
+{
+    nurbs_array_t pool;
+    if (nurbs_array_init(&pool, NULL, sizeof(nurbs_Point), t->npoints) < 0)
+        return NURBS_FALSE;
+    for (size_t i = 0; i < t->nspans; ++i) {
+        nurbs__TessRange *range = &t->ranges[i];
+        uint8_t *dst = nurbs_array_pushn(&pool, range->count);
+        memcpy(dst, t->pool.elts + range->offset * sizeof(nurbs_Point),
+               range->count * sizeof(nurbs_Point));
+        range->offset = pool.nelts - range->count;
+        range->capacity = range->count;
+    }
+    nurbs_array_destroy(&t->pool);
+    t->pool = pool;
+    return NURBS_TRUE;
+}
+
+nurbs_Tessellation *nurbs__tessResultNew(const nurbs_CurveData *data,
+                                         const nurbs_TessTolerance *tol)
+{
+    if (!(tol->chord > 0.0) || !(tol->angle >= 0.0))
+        return NULL;
+
+    nurbs_Tessellation *t =
+        (nurbs_Tessellation *)nurbs__memAlloc(sizeof(nurbs_Tessellation));
+    if (t == NULL)
+        return NULL;
+    t->data = data;
+    t->tol = *tol;
+    t->nspans = data->nknots - 2 * (size_t)data->degree - 1;
+    t->npoints = 0;
+    nurbs_array_init(&t->pool, NULL, sizeof(nurbs_Point), 0);
+    t->ranges = (nurbs__TessRange *)nurbs__memCalloc(t->nspans,
+                                                     sizeof(nurbs__TessRange));
+    if (t->ranges == NULL)
+        goto fail;
+
+    /* each span gets the spare room of the pool and keeps what it used */
+    for (size_t i = 0; i < t->nspans; ++i) {
+        nurbs__TessRange *range = &t->ranges[i];
+        size_t at = t->pool.nelts;
+        if (t->pool.nalloc - at < NURBS__TESSINLINE &&
+            nurbs_array_reserve(&t->pool, 2 * at + NURBS__TESSINLINE) < 0)
+            goto fail;
+        range->offset = at;
+        range->capacity = t->pool.nalloc - at;
+        if (!nurbs__tessRetessellate(t, i))
+            goto fail;
+        if (t->pool.nelts == at)
+            nurbs_array_pushn(&t->pool, range->count);
+        range->capacity = range->count;
+    }
+    if (t->pool.nelts != t->npoints && !nurbs__tessCompact(t))
+        goto fail;
+    t->end = nurbs__evalCurvePoint(data, data->knots[data->nknots -
+                                                     data->degree - 1]);
+    return t;
+
+fail:
+    nurbs__tessResultFree(t);
+    return NULL;
+}
+
+int nurbs__tessResultUpdate(nurbs_Tessellation *t, size_t first, size_t n,
+                            size_t *span0, size_t *span1)
+{
+    const nurbs_CurveData *data = t->data;
+    size_t p = data->degree;
+
+    /* control point i weighs on the knot spans i - p .. i of the domain */
+    size_t a = first > p ? first - p : 0;
+    size_t b = first + n < t->nspans ? first + n : t->nspans;
+    if (n == 0)
+        a = b = 0;
+    for (size_t i = a; i < b; ++i) {
+        if (!nurbs__tessRetessellate(t, i))
+            return NURBS_FALSE;
+    }
+    if (t->pool.nelts - t->npoints > t->npoints + NURBS__TESSINLINE &&
+        !nurbs__tessCompact(t))
+        return NURBS_FALSE;
+    if (b == t->nspans) {
+        t->end =
+            nurbs__evalCurvePoint(data, data->knots[data->nknots - p - 1]);
+    }
+
+    if (span0 != NULL)
+        *span0 = a;
+    if (span1 != NULL)
+        *span1 = b;
+    return NURBS_TRUE;
+}
+
+size_t nurbs__tessResultSpans(const nurbs_Tessellation *t)
+{
+    return t->nspans;
+}
+
+const nurbs_Point *nurbs__tessResultSpan(const nurbs_Tessellation *t,
+                                         size_t span, size_t *n)
+{
+    const nurbs__TessRange *range = &t->ranges[span];
+    *n = range->count;
+    return (const nurbs_Point *)(t->pool.elts +
+                                 range->offset * sizeof(nurbs_Point));
+}
+
+size_t nurbs__tessResultPoints(const nurbs_Tessellation *t,
+                               nurbs_Point *points, size_t first, size_t cap)
+{
+    size_t total = t->npoints + 1;
+    if (points == NULL || first >= total)
+        return total;
+
+    /* whole spans before the window are skipped by their counts */
+    size_t at = 0, stored = 0;
+    for (size_t i = 0; i < t->nspans && stored < cap; ++i) {
+        const nurbs__TessRange *range = &t->ranges[i];
+        if (at + range->count > first) {
+            size_t skip = first > at ? first - at : 0;
+            size_t m = range->count - skip;
+            if (m > cap - stored)
+                m = cap - stored;
+            memcpy(points + stored,
+                   t->pool.elts + (range->offset + skip) * sizeof(nurbs_Point),
+                   m * sizeof(nurbs_Point));
+            stored += m;
+        }
+        at += range->count;
+    }
+    if (stored < cap)
+        points[stored] = t->end;
+    return total;
+}
+
+void nurbs__tessResultFree(nurbs_Tessellation *t)
+{
+    if (t == NULL)
+        return;
+    nurbs_array_destroy(&t->pool);
+    nurbs__memFree(t->ranges);
+    nurbs__memFree(t);
+}
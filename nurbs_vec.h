@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2023-present Merlot.Rain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef NURBS_VEC_H
+#define NURBS_VEC_H
+
+#include "nurbs.h"
+#include <math.h>
+
+/*
+ * Value-semantics vector math. Everything is static inline and passes small
+ * structs by value, so the compiler can keep the operands in registers and
+ * fold whole expressions together.
+ */
+
+#ifndef NURBS__TOLERANCE
+#define NURBS__TOLERANCE (1e-6)
+#endif
+
+typedef nurbs_HPoint nurbs__Vec4; /* homogeneous point (wx, wy, wz, w) */
+
+/* ----------------------------------- 3D ----------------------------------- */
+
+static inline nurbs_Vector nurbs__vec(double x, double y, double z)
+{
+    nurbs_Vector r = {x, y, z};
+    return r;
+}
+
+static inline nurbs_Vector nurbs__vecAdd(nurbs_Vector a, nurbs_Vector b)
+{
+    return nurbs__vec(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+static inline nurbs_Vector nurbs__vecSub(nurbs_Vector a, nurbs_Vector b)
+{
+    return nurbs__vec(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static inline nurbs_Vector nurbs__vecMul(nurbs_Vector v, double a)
+{
+    return nurbs__vec(v.x * a, v.y * a, v.z * a);
+}
+
+static inline nurbs_Vector nurbs__vecDiv(nurbs_Vector v, double a)
+{
+    return nurbs__vec(v.x / a, v.y / a, v.z / a);
+}
+
+static inline double nurbs__vecDot(nurbs_Vector a, nurbs_Vector b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline nurbs_Vector nurbs__vecCross(nurbs_Vector a, nurbs_Vector b)
+{
+    return nurbs__vec(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+                      a.x * b.y - a.y * b.x);
+}
+
+static inline double nurbs__vecNormSquared(nurbs_Vector v)
+{
+    return v.x * v.x + v.y * v.y + v.z * v.z;
+}
+
+static inline double nurbs__vecNorm(nurbs_Vector v)
+{
+    return sqrt(nurbs__vecNormSquared(v));
+}
+
+static inline nurbs_Vector nurbs__vecNormalized(nurbs_Vector v)
+{
+    return nurbs__vecDiv(v, nurbs__vecNorm(v));
+}
+
+static inline int nurbs__vecIsZero(nurbs_Vector v)
+{
+    return fabs(v.x) <= NURBS__TOLERANCE && fabs(v.y) <= NURBS__TOLERANCE &&
+           fabs(v.z) <= NURBS__TOLERANCE;
+}
+
+/* origin + u * dir */
+static inline nurbs_Point nurbs__vecOnRay(nurbs_Point origin, nurbs_Vector dir,
+                                          double u)
+{
+    return nurbs__vec(origin.x + u * dir.x, origin.y + u * dir.y,
+                      origin.z + u * dir.z);
+}
+
+static inline double nurbs__distSquared(nurbs_Point a, nurbs_Point b)
+{
+    return nurbs__vecNormSquared(nurbs__vecSub(a, b));
+}
+
+static inline double nurbs__dist(nurbs_Point a, nurbs_Point b)
+{
+    return sqrt(nurbs__distSquared(a, b));
+}
+
+/* ----------------------------------- 4D ----------------------------------- */
+
+static inline nurbs__Vec4 nurbs__vec4(double x, double y, double z, double w)
+{
+    nurbs__Vec4 r = {x, y, z, w};
+    return r;
+}
+
+static inline nurbs__Vec4 nurbs__vec4Add(nurbs__Vec4 a, nurbs__Vec4 b)
+{
+    return nurbs__vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+
+static inline nurbs__Vec4 nurbs__vec4Sub(nurbs__Vec4 a, nurbs__Vec4 b)
+{
+    return nurbs__vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+}
+
+static inline nurbs__Vec4 nurbs__vec4Mul(nurbs__Vec4 v, double a)
+{
+    return nurbs__vec4(v.x * a, v.y * a, v.z * a, v.w * a);
+}
+
+/* a + v * s, the accumulation step of every basis function sum */
+static inline nurbs__Vec4 nurbs__vec4Madd(nurbs__Vec4 a, nurbs__Vec4 v,
+                                          double s)
+{
+    return nurbs__vec4(a.x + v.x * s, a.y + v.y * s, a.z + v.z * s,
+                       a.w + v.w * s);
+}
+
+/* (1 - t) * a + t * b */
+static inline nurbs__Vec4 nurbs__vec4Lerp(nurbs__Vec4 a, nurbs__Vec4 b,
+                                          double t)
+{
+    return nurbs__vec4Madd(nurbs__vec4Mul(a, 1.0 - t), b, t);
+}
+
+/* the homogeneous form of a point with weight w */
+static inline nurbs__Vec4 nurbs__vec4Homogenize(nurbs_Point p, double w)
+{
+    return nurbs__vec4(p.x * w, p.y * w, p.z * w, w);
+}
+
+/* the cartesian point of a homogeneous one */
+static inline nurbs_Point nurbs__vec4Dehomogenize(nurbs__Vec4 h)
+{
+    return nurbs__vec(h.x / h.w, h.y / h.w, h.z / h.w);
+}
+
+/*
+ * derivative of the cartesian curve from the homogeneous point h and its
+ * derivative dh: (dh.xyz - dh.w * p) / h.w
+ */
+static inline nurbs_Vector nurbs__vec4DehomogenizeD1(nurbs__Vec4 h,
+                                                     nurbs__Vec4 dh)
+{
+    nurbs_Point p = nurbs__vec4Dehomogenize(h);
+    return nurbs__vec((dh.x - dh.w * p.x) / h.w, (dh.y - dh.w * p.y) / h.w,
+                      (dh.z - dh.w * p.z) / h.w);
+}
+
+#endif /* NURBS_VEC_H */